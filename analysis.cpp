@@ -1,100 +1,210 @@
 #include <iostream>
 #include <vector>
-#include <map>
 #include <string>
 #include <iomanip>
 #include <random>
 #include <chrono>
 #include <fstream>
 #include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
 #include "analysis.h"
 #include "scheduler.h"
+#include "timeline_store.h"
 
-void analyzeAlgorithms() {
-    std::vector<Task> originalTasks;
-    std::random_device rd;
-    std::mt19937 gen(rd());
+// forEach(f) must call f(const TimelineEntry&) for every slice in time order
+template <typename ForEach>
+static RunMetrics computeMetrics(const std::vector<Task> &tasks, ForEach forEach) {
+    std::unordered_map<int,int> firstStart, completion;
+    forEach([&](const TimelineEntry &e) {
+        firstStart.try_emplace(e.id, e.start_time);
+        completion[e.id] = e.end_time;
+    });
+
+    double totalResp=0, totalTat=0, totalWait=0;
+    int n = tasks.size();
+    for (auto &t : tasks) {
+        int burst = t.remaining_time;
+        int resp = firstStart[t.id] - t.arrival_time;
+        int tat  = completion[t.id]    - t.arrival_time;
+        int wt   = tat - burst;
+        totalResp += resp;
+        totalTat  += tat;
+        totalWait += wt;
+    }
+    return { totalResp/n, totalTat/n, totalWait/n };
+}
+
+RunMetrics timelineMetrics(const std::vector<Task> &tasks, const std::vector<TimelineEntry> &timeline) {
+    return computeMetrics(tasks, [&](auto f) { for (const auto &e : timeline) f(e); });
+}
+
+RunMetrics timelineMetrics(const std::vector<Task> &tasks, const TimelineReader &timeline) {
+    return computeMetrics(tasks, [&](auto f) { timeline.for_each(f); });
+}
+
+const char *algorithmName(Algorithm a) {
+    static const char *names[] = { "FCFS", "RR", "PRIORITY", "SJF", "MLQ", "MLFQ", "EDF", "CFS" };
+    return names[a];
+}
 
-    // generating random tasks for analysis
+std::vector<Task> randomWorkload(int n, unsigned seed) {
+    std::mt19937 gen(seed);
     std::uniform_int_distribution<> pri_d(1, 10);
     std::uniform_int_distribution<> rem_d(1, 500);
     std::uniform_int_distribution<> arr_d(0, 10);
     std::uniform_int_distribution<> dl_d(1, 500);
 
-    for (int i = 1; i <= 100; ++i) {
+    std::vector<Task> tasks;
+    tasks.reserve(n);
+    for (int i = 1; i <= n; ++i) {
         Task tk;
         tk.id             = i;
         tk.priority       = pri_d(gen);
         tk.remaining_time = rem_d(gen);
         tk.arrival_time   = arr_d(gen);
         tk.deadline       = dl_d(gen);
-        originalTasks.push_back(tk);
+        tk.level          = 0;
+        tasks.push_back(tk);
     }
+    // the policies expect tasks in arrival order
+    std::stable_sort(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+        return a.arrival_time < b.arrival_time;
+    });
+    return tasks;
+}
 
-    struct Metrics { std::string name; double resp, tat, wait; };
-    std::vector<Metrics> all;
+// two-sided 95% Student t quantile for `df` degrees of freedom
+static double t95(int df) {
+    static const double table[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+                                    2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+                                    2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if (df <= 0) return 0;
+    if (df <= 30) return table[df];
+    return df <= 60 ? 2.000 : df <= 120 ? 1.980 : 1.960;
+}
 
-    std::vector<Algorithm> algos = { FCFS, RR, PRIORITY, SJF, MLQ, MLFQ, EDF, CFS };
-    std::vector<std::string> names = { "FCFS", "RR", "PRIORITY", "SJF", "MLQ", "MLFQ", "EDF", "CFS" };
-    const int timeQuantum = 50;
+std::vector<SweepResult> runSweep(const SweepConfig &cfg) {
+    struct Job { std::size_t cell; int seed; };
+    struct Run { RunMetrics m; double us; };
 
-    std::cout << std::fixed << std::setprecision(2);
+    // cells in output order; jobs biggest workload first so the pool drains evenly
+    std::vector<SweepResult> cells;
+    for (int size : cfg.sizes)
+        for (int q : cfg.quanta)
+            for (Algorithm a : cfg.algorithms)
+                cells.push_back({ a, q, size, 0, {}, {}, 0.0 });
+    const int seeds = std::max(1, cfg.seeds);
+
+    std::vector<Job> jobs;
+    for (std::size_t c = 0; c < cells.size(); ++c)
+        for (int k = 0; k < seeds; ++k)
+            jobs.push_back({ c, k });
+    std::stable_sort(jobs.begin(), jobs.end(), [&](const Job &a, const Job &b) {
+        return cells[a.cell].size > cells[b.cell].size;
+    });
 
-    for (size_t i = 0; i < algos.size(); ++i) {
-        Scheduler sched(algos[i], timeQuantum, [](const std::string&) {});
-        sched.tasks = originalTasks;
+    // every Scheduler is independent, so workers share nothing but the job counter
+    std::vector<Run> runs(cells.size() * seeds);
+    std::atomic<std::size_t> next{0};
+    auto worker = [&] {
+        for (std::size_t j; (j = next.fetch_add(1)) < jobs.size();) {
+            const SweepResult &cell = cells[jobs[j].cell];
+            std::vector<Task> tasks = randomWorkload(cell.size, cfg.base_seed + jobs[j].seed);
 
-        auto start = std::chrono::high_resolution_clock::now();
-        sched.run();
-        auto end   = std::chrono::high_resolution_clock::now();
-        long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            Scheduler sched(cell.algorithm, cell.quantum, [](const std::string&) {});
+            sched.log_level = LOG_OFF;
+            sched.tasks = tasks;
 
-        std::map<int,int> firstStart, completion;
-        for (const auto &e : sched.timeline()) {
-            firstStart.try_emplace(e.id, e.start_time);
-            completion[e.id] = e.end_time;
+            auto start = std::chrono::steady_clock::now();
+            sched.run();
+            auto end   = std::chrono::steady_clock::now();
+
+            Run &r = runs[jobs[j].cell * seeds + jobs[j].seed];
+            r.m = timelineMetrics(tasks, sched.timeline());
+            r.us = std::chrono::duration<double, std::micro>(end - start).count();
         }
+    };
+
+    int threads = cfg.threads > 0 ? cfg.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(1, std::min<int>(threads, static_cast<int>(jobs.size())));
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool) th.join();
 
-        double totalResp=0, totalTat=0, totalWait=0;
-        int n = originalTasks.size();
-        for (auto &t : originalTasks) {
-            int burst = t.remaining_time;
-            int resp = firstStart[t.id] - t.arrival_time;
-            int tat  = completion[t.id]    - t.arrival_time;
-            int wt   = tat - burst;
-            totalResp += resp;
-            totalTat  += tat;
-            totalWait += wt;
+    for (std::size_t c = 0; c < cells.size(); ++c) {
+        const Run *r = &runs[c * seeds];
+        SweepResult &out = cells[c];
+        out.runs = seeds;
+
+        RunMetrics sum = {}, sq = {};
+        double us = 0;
+        for (int k = 0; k < seeds; ++k) {
+            sum.resp += r[k].m.resp; sum.tat += r[k].m.tat; sum.wait += r[k].m.wait;
+            us += r[k].us;
+        }
+        out.mean = { sum.resp / seeds, sum.tat / seeds, sum.wait / seeds };
+        out.elapsed_us = us / seeds;
+        for (int k = 0; k < seeds; ++k) {
+            sq.resp += std::pow(r[k].m.resp - out.mean.resp, 2);
+            sq.tat  += std::pow(r[k].m.tat  - out.mean.tat, 2);
+            sq.wait += std::pow(r[k].m.wait - out.mean.wait, 2);
         }
+        double f = seeds > 1 ? t95(seeds - 1) / std::sqrt(double(seeds)) : 0.0;
+        auto sd = [&](double s) { return seeds > 1 ? std::sqrt(s / (seeds - 1)) : 0.0; };
+        out.ci = { f * sd(sq.resp), f * sd(sq.tat), f * sd(sq.wait) };
+    }
+    return cells;
+}
 
-        double avgResp = totalResp/n;
-        double avgTat  = totalTat/n;
-        double avgWait = totalWait/n;
+// Algorithm,Response,Turnaround,Waiting stay the first columns so
+// plot_metrics.py keeps working on single-quantum, single-size sweeps
+bool writeSweepCsv(const std::string &path, const std::vector<SweepResult> &results) {
+    std::ofstream fout(path);
+    if (!fout) return false;
+    fout << std::fixed << std::setprecision(2);
+    fout << "Algorithm,Response,Turnaround,Waiting,Quantum,Tasks,Runs,"
+            "Response_CI,Turnaround_CI,Waiting_CI,Elapsed_us\n";
+    for (auto &r : results) {
+        fout << algorithmName(r.algorithm) << "," << r.mean.resp << "," << r.mean.tat << "," << r.mean.wait << ","
+             << r.quantum << "," << r.size << "," << r.runs << ","
+             << r.ci.resp << "," << r.ci.tat << "," << r.ci.wait << "," << r.elapsed_us << "\n";
+    }
+    return static_cast<bool>(fout);
+}
+
+void analyzeAlgorithms() {
+    SweepConfig cfg;
 
-        std::cout << names[i] << " Metrics:\n"
-                  << "  Elapsed Time       = " << elapsed << " ms\n"
-                  << "  Avg Response Time   = " << avgResp << "\n"
-                  << "  Avg Turnaround Time = " << avgTat  << "\n"
-                  << "  Avg Waiting Time    = " << avgWait << "\n\n";
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SweepResult> all = runSweep(cfg);
+    auto end   = std::chrono::steady_clock::now();
 
-        all.push_back({ names[i], avgResp, avgTat, avgWait });
+    std::cout << std::fixed << std::setprecision(2);
+    for (auto &r : all) {
+        std::cout << algorithmName(r.algorithm) << " Metrics (q=" << r.quantum << ", " << r.size
+                  << " tasks, " << r.runs << " runs, 95% CI):\n"
+                  << "  Elapsed Time        = " << r.elapsed_us << " us/run\n"
+                  << "  Avg Response Time   = " << r.mean.resp << " +- " << r.ci.resp << "\n"
+                  << "  Avg Turnaround Time = " << r.mean.tat  << " +- " << r.ci.tat  << "\n"
+                  << "  Avg Waiting Time    = " << r.mean.wait << " +- " << r.ci.wait << "\n\n";
     }
+    std::cout << "Sweep of " << all.size() << " cells took "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
 
-    std::ofstream fout("metrics.csv");
     std::cout<<"Writing metrics to metrics.csv\n";
-    if (!fout) {
+    if (!writeSweepCsv("metrics.csv", all)) {
         std::cerr << "Error opening metrics.csv for writing\n";
         return;
     }
-    fout << "Algorithm,Response,Turnaround,Waiting\n";
-    for (auto &m : all) {
-        std::cout << m.name << "," << m.resp << "," << m.tat << "," << m.wait << "\n";
-        fout << m.name << "," << m.resp << "," << m.tat << "," << m.wait << "\n";
-    }
 
     // int ret = std::system(R"(python "C:\Users\DELL\thread-scheduler\plot_metrics.py")");
     // std::cout << "return code: " << ret << "\n";
     // if (ret != 0) {
     //     std::cerr << "ERROR: plotting script returned code " << ret << "\n";
     // }
-}
+}
\ No newline at end of file
@@ -1,5 +1,47 @@
 #ifndef ANALYSIS_H 
 #define ANALYSIS_H 
 
+#include <string>
+#include <vector>
+#include "scheduler.h"
+
+class TimelineReader;
+
+// average response, turnaround and waiting time of `tasks` over a timeline
+struct RunMetrics { double resp, tat, wait; };
+RunMetrics timelineMetrics(const std::vector<Task> &tasks, const std::vector<TimelineEntry> &timeline);
+RunMetrics timelineMetrics(const std::vector<Task> &tasks, const TimelineReader &timeline);
+
+// the random workload analyzeAlgorithms() has always used, scaled to n
+// tasks and sorted by arrival time
+std::vector<Task> randomWorkload(int n, unsigned seed);
+
+// Parameter sweep: every algorithm x quantum x workload size is run on
+// `seeds` random workloads, spread over a pool of `threads` workers.
+struct SweepConfig {
+    std::vector<Algorithm> algorithms = { FCFS, RR, PRIORITY, SJF, MLQ, MLFQ, EDF, CFS };
+    std::vector<int> quanta = { 50 };
+    std::vector<int> sizes = { 100 };
+    int seeds = 30;
+    unsigned base_seed = 1;     // workload k of a size uses base_seed + k
+    int threads = 0;            // 0 = std::thread::hardware_concurrency()
+};
+
+// one (algorithm, quantum, size) cell, aggregated over its seeds;
+// *_ci are half-widths of the 95% confidence interval of the mean
+struct SweepResult {
+    Algorithm algorithm;
+    int quantum;
+    int size;
+    int runs;
+    RunMetrics mean;
+    RunMetrics ci;
+    double elapsed_us;          // mean wall time of one run
+};
+
+std::vector<SweepResult> runSweep(const SweepConfig &cfg);
+bool writeSweepCsv(const std::string &path, const std::vector<SweepResult> &results);
+const char *algorithmName(Algorithm a);
+
 void analyzeAlgorithms();
 #endif
\ No newline at end of file
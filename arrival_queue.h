@@ -0,0 +1,50 @@
+#ifndef ARRIVAL_QUEUE_H
+#define ARRIVAL_QUEUE_H
+
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Arrival events for the threaded policies, ordered by (arrival_time, index).
+// Policies admit everything that has arrived by `now` in O(log n) per task and,
+// when nothing is ready, jump the clock straight to next_time() instead of
+// stepping through idle time.
+class ArrivalQueue {
+public:
+    // arrival_time[i] is the arrival of task i
+    explicit ArrivalQueue(const std::vector<int>& arrival_time) {
+        std::vector<Event> events;
+        events.reserve(arrival_time.size());
+        for (std::size_t i = 0; i < arrival_time.size(); ++i)
+            events.emplace_back(arrival_time[i], i);
+        heap = Heap(std::greater<Event>(), std::move(events));
+    }
+
+    bool empty() const { return heap.empty(); }
+
+    // arrival time of the next pending task; only valid if !empty()
+    int next_time() const { return heap.top().first; }
+
+    // remove and return the earliest pending task
+    std::size_t pop() {
+        std::size_t idx = heap.top().second;
+        heap.pop();
+        return idx;
+    }
+
+    // hand every task with arrival_time <= now to admit(idx), in arrival order
+    template <typename Admit>
+    void admit_until(int now, Admit admit) {
+        while (!heap.empty() && heap.top().first <= now)
+            admit(pop());
+    }
+
+private:
+    typedef std::pair<int, std::size_t> Event;
+    typedef std::priority_queue<Event, std::vector<Event>, std::greater<Event>> Heap;
+    Heap heap;
+};
+
+#endif // ARRIVAL_QUEUE_H
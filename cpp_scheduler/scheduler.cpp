@@ -3,10 +3,22 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <vector>
+#include <deque>
+#include <queue>
 #include <chrono>
 #include <algorithm>
 #include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 // ------------------------------
 // Configuration constants
@@ -17,21 +29,152 @@ const int WORK_SLICE_MS = 10;    // Each work slice duration (ms)
 const int TOTAL_WORK_MS = 500;   // Total work required per task (ms)
 const int FEEDBACK_FACTOR = 50;  // Factor for dynamic feedback adjustment
 
+// ------------------------------
+// Parker: one-permit thread sleep/wake
+// ------------------------------
+// unpark() leaves a permit that the next park() consumes, so a wake-up
+// sent before the sleeper gets there is never lost. Only a thread that
+// actually sleeps costs a system call: a futex on Linux, a condition
+// variable elsewhere.
+class Parker
+{
+public:
+    void park()
+    {
+        // NOTIFIED -> EMPTY returns at once; EMPTY -> PARKED sleeps
+        if (state.fetch_sub(1, std::memory_order_acquire) == NOTIFIED)
+            return;
+        for (;;)
+        {
+            sleep();
+            int expected = NOTIFIED;
+            if (state.compare_exchange_strong(expected, EMPTY, std::memory_order_acquire))
+                return;
+        }
+    }
+
+    void unpark()
+    {
+        if (state.exchange(NOTIFIED, std::memory_order_release) == PARKED)
+            wake();
+    }
+
+private:
+    static const int PARKED = -1, EMPTY = 0, NOTIFIED = 1;
+    std::atomic<int> state{EMPTY};
+
+#if defined(__linux__)
+    void sleep()
+    {
+        syscall(SYS_futex, reinterpret_cast<int *>(&state), FUTEX_WAIT_PRIVATE, PARKED, nullptr, nullptr, 0);
+    }
+    void wake()
+    {
+        syscall(SYS_futex, reinterpret_cast<int *>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+#else
+    std::mutex m;
+    std::condition_variable cv;
+    void sleep()
+    {
+        std::unique_lock<std::mutex> lock(m);
+        while (state.load(std::memory_order_relaxed) == PARKED)
+            cv.wait(lock);
+    }
+    void wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+        }
+        cv.notify_one();
+    }
+#endif
+};
+
+// ------------------------------
+// Task state export (C ABI)
+// ------------------------------
+// Task state is published into an array of fixed-layout records that the
+// Python bindings (schedulers/engine.py mirrors the layout) map straight
+// into a numpy array: no copies, no string parsing, no engine lock. Each
+// record has its own seqlock, so a poll only retries the few records that
+// changed under it. The records move when the table grows; readers then
+// see a new generation and re-map. Old arrays stay alive until the engine
+// is cleaned up.
+extern "C"
+{
+    enum
+    {
+        THREAD_STATE_ABI_VERSION = 1
+    };
+
+    enum ThreadStateCode
+    {
+        THREAD_READY = 0,
+        THREAD_RUNNING = 1,
+        THREAD_FINISHED = 2
+    };
+
+    struct ThreadStateRecord
+    {
+        uint32_t seq;             // odd while the record is being written
+        int32_t id;
+        int32_t state;            // ThreadStateCode
+        int32_t base_priority;
+        int32_t dynamic_priority;
+        int32_t cpu_time;         // ms
+        int32_t remaining_work;   // ms
+        uint32_t dispatches;      // quanta granted so far
+    };
+
+    struct ThreadStateTable
+    {
+        uint32_t abi_version;     // THREAD_STATE_ABI_VERSION
+        uint32_t record_size;     // sizeof(ThreadStateRecord)
+        uint64_t generation;      // odd while records moves, then bumped again
+        uint64_t version;         // bumped after every record update
+        uint64_t count;           // records in use, in add order
+        uint64_t capacity;
+        ThreadStateRecord *records;
+    };
+}
+
+// Seqlock writes; there is one writer at a time (see SchedulerEngine).
+template <typename T>
+static void storeOnce(T &field, T value)
+{
+    *static_cast<volatile T *>(&field) = value;
+}
+
+template <typename T>
+static T loadOnce(const T &field)
+{
+    return *static_cast<const volatile T *>(&field);
+}
+
 // ------------------------------
 // Task Structure
 // ------------------------------
 struct Task
 {
     int id;
-    int basePriority;    // Initial fixed priority
-    int dynamicPriority; // Priority adjusted dynamically
-    int cpuTime;         // Accumulated CPU time (ms)
-    int remainingWork;   // Work left (ms)
-    bool run_flag;       // Flag to signal running
-    bool finished;       // Finished flag
-
-    std::mutex mtx;
-    std::condition_variable cv;
+    int basePriority;                  // Initial fixed priority
+    std::atomic<int> dynamicPriority;  // Priority adjusted dynamically
+    std::atomic<int> cpuTime;          // Accumulated CPU time (ms)
+    int remainingWork;                 // Work left (ms)
+    std::atomic<bool> finished;        // Finished flag
+
+    // Engine bookkeeping. The dispatcher and the worker running the task
+    // take turns with these; each handover goes through the engine's inbox
+    // or the worker's parker, which order the accesses.
+    Task *next = nullptr;              // link on the engine's inbox
+    bool admitted = false;             // seen by the dispatcher yet?
+    int worker = -1;                   // pool worker running its quantum
+    std::size_t seq = 0;               // add order, breaks priority ties
+    std::chrono::steady_clock::time_point grantedAt;
+    long long dispatchNs = 0;          // grant-to-run latency of the last dispatch
+    long slot = -1;                    // record in the state table, once published
+    uint32_t dispatchCount = 0;
 
     Task(int id, int basePriority)
         : id(id),
@@ -39,44 +182,37 @@ struct Task
           dynamicPriority(basePriority),
           cpuTime(0),
           remainingWork(TOTAL_WORK_MS),
-          run_flag(false),
           finished(false)
     {
     }
 
-    // Simulated work: loop until work is complete.
-    void work()
+    // Simulated work for one time quantum; returns true once the task is done.
+    bool work()
     {
-        while (true)
+        for (int slice = 0; slice < TIME_QUANTUM_MS / WORK_SLICE_MS; ++slice)
         {
-            // Wait until run_flag is set or finished.
-            std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [&]
-                    { return run_flag || finished; });
-            if (finished)
-                break;
-            lock.unlock();
-
             // Simulate work by sleeping WORK_SLICE_MS.
             // std::this_thread::sleep_for(std::chrono::milliseconds(WORK_SLICE_MS));
             cpuTime += WORK_SLICE_MS;
             remainingWork -= WORK_SLICE_MS;
 
-            // Log progress.
-            std::cout << "[Task " << id << "] Running... CPU time = "
-                      << cpuTime << " ms, remaining work = "
-                      << remainingWork << " ms\n";
+            // Log progress, one write per line as workers share stdout.
+            std::ostringstream line;
+            line << "[Task " << id << "] Running... CPU time = "
+                 << cpuTime << " ms, remaining work = "
+                 << remainingWork << " ms\n";
+            std::cout << line.str();
 
             if (remainingWork <= 0)
             {
-                std::unique_lock<std::mutex> lock2(mtx);
                 finished = true;
-                run_flag = false;
-                cv.notify_all();
-                std::cout << "[Task " << id << "] Finished execution.\n";
-                break;
+                line.str("");
+                line << "[Task " << id << "] Finished execution.\n";
+                std::cout << line.str();
+                return true;
             }
         }
+        return false;
     }
 };
 
@@ -90,127 +226,349 @@ enum SchedulerType
     PRIORITY
 };
 
+// Task work runs on a fixed pool of worker threads, so the thread count
+// follows the cores rather than the tasks. Whenever a worker is idle the
+// dispatcher lets the policy pick a task and grants it a quantum on that
+// worker; the worker runs it, pushes the task onto the engine's lock-free
+// inbox and unparks the dispatcher, which sleeps otherwise. New tasks
+// arrive through the same inbox, so neither dispatch nor addTask takes a
+// lock, and the ready queue is owned by the dispatcher thread alone.
+//
+// The state table has a single writer: the dispatcher while run() is
+// active, otherwise whoever registers a task (under engine_mtx).
 class SchedulerEngine
 {
 public:
     SchedulerEngine(SchedulerType type)
         : schedType(type)
     {
+        stateTable.abi_version = THREAD_STATE_ABI_VERSION;
+        stateTable.record_size = sizeof(ThreadStateRecord);
     }
 
-    // Add a task pointer to our list.
-    void addTask(Task *t)
+    // Pool size for the next run(); 0 means one worker per hardware thread.
+    void setWorkers(int n)
     {
-        std::lock_guard<std::mutex> lock(engine_mtx);
-        tasks.push_back(t);
+        workerCount.store(n > 0 ? n : 0, std::memory_order_relaxed);
     }
 
-    // Run the scheduler until all tasks are finished.
+    // Add a task with burst_quanta quanta of work; safe to call while
+    // run() is dispatching. The engine owns the task.
+    void addTask(int id, int basePriority, int burstQuanta)
+    {
+        Task *t;
+        {
+            std::lock_guard<std::mutex> lock(engine_mtx);
+            tasks.emplace_back(id, basePriority);
+            t = &tasks.back();
+            t->remainingWork = burstQuanta * TIME_QUANTUM_MS;
+            // while dispatching, the dispatcher publishes it when it arrives
+            if (!dispatching)
+                appendRecord(t);
+        }
+        push(t);
+    }
+
+    // Run the scheduler until all tasks are finished. A second, concurrent
+    // run() of the same engine returns at once.
     void run()
     {
-        // Start each task's work in a separate thread.
-        for (Task *t : tasks)
         {
-            taskThreads.emplace_back(&Task::work, t);
+            std::lock_guard<std::mutex> lock(engine_mtx);
+            if (dispatching)
+                return;
+            dispatching = true;
+        }
+        int n = workerCount.load(std::memory_order_relaxed);
+        if (n == 0)
+            n = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::unique_ptr<Worker>> pool;
+        std::vector<int> idle;
+        for (int w = 0; w < n; ++w)
+        {
+            pool.emplace_back(new Worker());
+            pool.back()->thread = std::thread(&SchedulerEngine::workerLoop, this, pool.back().get());
+            idle.push_back(n - 1 - w); // hand out worker 0 first
         }
+        std::size_t live = 0; // tasks admitted and not finished
 
         while (true)
         {
+            // Take everything that arrived since the last pass, oldest first.
+            Task *chain = inbox.exchange(nullptr, std::memory_order_acquire);
+            Task *fifo = nullptr;
+            while (chain)
             {
-                std::lock_guard<std::mutex> lock(engine_mtx);
-                // Remove finished tasks.
-                tasks.erase(std::remove_if(tasks.begin(), tasks.end(),
-                                           [](Task *t)
-                                           { return t->finished; }),
-                            tasks.end());
-                if (tasks.empty())
-                    break;
+                Task *n = chain->next;
+                chain->next = fifo;
+                fifo = chain;
+                chain = n;
             }
-            // For each remaining task (using simple round-robin or chosen scheduling),
-            // signal it to run for one time quantum.
-            Task *nextTask = selectTask();
-            if (nextTask)
+            for (Task *t = fifo; t;)
             {
-                runTaskForQuantum(nextTask);
-                applyDynamicFeedback(nextTask);
+                Task *n = t->next;
+                if (!t->admitted)
+                {
+                    t->admitted = true;
+                    t->seq = nextSeq++;
+                    if (t->slot < 0)
+                        appendRecord(t);
+                    ++live;
+                    enqueue(t, false);
+                }
+                else
+                {
+                    // back from its quantum; its worker is free again
+                    idle.push_back(t->worker);
+                    ++dispatches;
+                    dispatchNsTotal += t->dispatchNs;
+                    if (t->finished)
+                    {
+                        --live;
+                        publish(t, THREAD_FINISHED);
+                    }
+                    else
+                    {
+                        applyDynamicFeedback(t);
+                        publish(t, THREAD_READY);
+                        enqueue(t, true);
+                    }
+                }
+                t = n;
             }
+
+            while (!idle.empty())
+            {
+                Task *nextTask = selectTask();
+                if (!nextTask)
+                    break;
+                runTaskForQuantum(nextTask, *pool[idle.back()], idle.back());
+                idle.pop_back();
+            }
+            if (live == 0)
+                break;
+            // Nothing to do until a task returns or a new one arrives.
+            if (!inbox.load(std::memory_order_acquire))
+                dispatcher.park();
         }
 
-        // Wait for all task threads to finish.
-        for (std::thread &th : taskThreads)
+        // Stop the pool.
+        for (auto &w : pool)
         {
-            if (th.joinable())
-                th.join();
+            w->task = nullptr;
+            w->parker.unpark();
+            w->thread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(engine_mtx);
+            dispatching = false;
         }
         std::cout << "All tasks finished.\n";
+        if (dispatches > 0)
+            std::cout << "[Scheduler] " << dispatches << " dispatches, mean dispatch latency "
+                      << dispatchNsTotal / dispatches / 1000.0 << " us\n";
     }
 
-    // Generate a summary string of all tasks' states.
-    std::string getStates()
+    // Generate a summary string of all tasks' states; it stays valid
+    // until the next call on this engine.
+    const char *getStates()
     {
         std::lock_guard<std::mutex> lock(engine_mtx);
         std::stringstream ss;
-        for (auto t : allTasks)
+        for (const Task &t : tasks)
         {
-            ss << t->id << "," << (t->finished ? "Finished" : "Running") << ","
-               << t->dynamicPriority << "," << t->cpuTime << ";";
+            ss << t.id << "," << (t.finished ? "Finished" : "Running") << ","
+               << t.dynamicPriority << "," << t.cpuTime << ";";
         }
-        return ss.str();
+        statesOut = ss.str();
+        return statesOut.c_str();
+    }
+
+    const ThreadStateTable *states() const
+    {
+        return &stateTable;
     }
 
-    // Register tasks for final summary.
-    void registerTask(Task *t)
+    // Copy up to max records, each one consistent on its own.
+    std::size_t copyStates(ThreadStateRecord *out, std::size_t max) const
     {
-        allTasks.push_back(t);
+        for (;;)
+        {
+            // records, capacity and count only go together within one
+            // generation, so all three are read under it before any record
+            uint64_t gen = loadOnce(stateTable.generation);
+            if (gen & 1)
+                continue;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const ThreadStateRecord *recs = loadOnce(stateTable.records);
+            uint64_t cap = loadOnce(stateTable.capacity);
+            uint64_t count = loadOnce(stateTable.count);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (loadOnce(stateTable.generation) != gen)
+                continue;
+            std::size_t n = std::min<std::size_t>(max, std::min(count, cap));
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                for (;;)
+                {
+                    uint32_t before = loadOnce(recs[i].seq);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    std::memcpy(&out[i], const_cast<const ThreadStateRecord *>(&recs[i]), sizeof(ThreadStateRecord));
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (!(before & 1) && loadOnce(recs[i].seq) == before)
+                        break;
+                }
+            }
+            // if the table moved while we copied, the records may be stale
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (loadOnce(stateTable.generation) == gen)
+                return n;
+        }
     }
 
 private:
+    // highest dynamic priority first, then the earliest added
+    struct ByPriority
+    {
+        bool operator()(const Task *a, const Task *b) const
+        {
+            if (a->dynamicPriority != b->dynamicPriority)
+                return a->dynamicPriority < b->dynamicPriority;
+            return a->seq > b->seq;
+        }
+    };
+
     SchedulerType schedType;
-    std::vector<Task *> tasks;
-    std::vector<Task *> allTasks; // For summary (all tasks ever added)
-    std::vector<std::thread> taskThreads;
-    std::mutex engine_mtx;
+    std::atomic<Task *> inbox{nullptr}; // Treiber stack: new and returning tasks
+    Parker dispatcher;
+    std::deque<Task *> ready;           // FCFS / RR, dispatcher only
+    std::priority_queue<Task *, std::vector<Task *>, ByPriority> byPriority; // PRIORITY
+    std::size_t nextSeq = 0;
+    long long dispatches = 0;
+    long long dispatchNsTotal = 0;
+    std::deque<Task> tasks;       // arena: every task ever added, in add order
+    std::string statesOut;        // getStates() result
+    std::atomic<int> workerCount{0};
+    std::mutex engine_mtx;        // guards tasks; never taken while dispatching
+    bool dispatching = false;     // guarded by engine_mtx
+    ThreadStateTable stateTable = {};
+    std::vector<std::unique_ptr<ThreadStateRecord[]>> stateBuffers; // current one last
 
-    // Choose next task based on scheduling algorithm.
-    Task *selectTask()
+    // Append t's record, growing the table if needed (state-table writer only).
+    void appendRecord(Task *t)
     {
-        std::lock_guard<std::mutex> lock(engine_mtx);
-        if (tasks.empty())
-            return nullptr;
-        if (schedType == FCFS)
+        if (stateTable.count == stateTable.capacity)
         {
-            return tasks.front();
+            std::size_t cap = std::max<std::size_t>(64, 2 * stateTable.capacity);
+            std::unique_ptr<ThreadStateRecord[]> grown(new ThreadStateRecord[cap]());
+            if (stateTable.count)
+                std::memcpy(grown.get(), stateTable.records, stateTable.count * sizeof(ThreadStateRecord));
+            storeOnce(stateTable.generation, stateTable.generation + 1);
+            std::atomic_thread_fence(std::memory_order_release);
+            storeOnce(stateTable.records, grown.get());
+            storeOnce(stateTable.capacity, static_cast<uint64_t>(cap));
+            std::atomic_thread_fence(std::memory_order_release);
+            storeOnce(stateTable.generation, stateTable.generation + 1);
+            stateBuffers.push_back(std::move(grown)); // readers may still map the old one
         }
-        else if (schedType == RR)
+        t->slot = static_cast<long>(stateTable.count);
+        publish(t, THREAD_READY);
+        std::atomic_thread_fence(std::memory_order_release);
+        storeOnce(stateTable.count, stateTable.count + 1);
+    }
+
+    // Rewrite t's record (state-table writer only).
+    void publish(Task *t, int state)
+    {
+        ThreadStateRecord &r = stateTable.records[t->slot];
+        uint32_t seq = r.seq;
+        storeOnce(r.seq, seq + 1);
+        std::atomic_thread_fence(std::memory_order_release);
+        storeOnce(r.id, static_cast<int32_t>(t->id));
+        storeOnce(r.state, static_cast<int32_t>(state));
+        storeOnce(r.base_priority, static_cast<int32_t>(t->basePriority));
+        storeOnce(r.dynamic_priority, static_cast<int32_t>(t->dynamicPriority));
+        storeOnce(r.cpu_time, static_cast<int32_t>(t->cpuTime));
+        storeOnce(r.remaining_work, static_cast<int32_t>(t->remainingWork));
+        storeOnce(r.dispatches, t->dispatchCount);
+        std::atomic_thread_fence(std::memory_order_release);
+        storeOnce(r.seq, seq + 2);
+        storeOnce(stateTable.version, stateTable.version + 1);
+    }
+
+    void push(Task *t)
+    {
+        Task *head = inbox.load(std::memory_order_relaxed);
+        do
         {
-            static size_t rr_index = 0;
-            Task *t = tasks[rr_index % tasks.size()];
-            rr_index = (rr_index + 1) % tasks.size();
-            return t;
-        }
-        else if (schedType == PRIORITY)
+            t->next = head;
+        } while (!inbox.compare_exchange_weak(head, t, std::memory_order_release, std::memory_order_relaxed));
+        dispatcher.unpark();
+    }
+
+    struct Worker
+    {
+        Parker parker;
+        Task *task = nullptr; // set by the dispatcher before unpark; null stops
+        std::thread thread;
+    };
+
+    // A pool worker: sleep until granted a task's quantum, run it, hand back.
+    void workerLoop(Worker *w)
+    {
+        for (;;)
         {
-            auto it = std::max_element(tasks.begin(), tasks.end(),
-                                       [](Task *a, Task *b)
-                                       { return a->dynamicPriority < b->dynamicPriority; });
-            return (it != tasks.end()) ? *it : nullptr;
+            w->parker.park();
+            Task *t = w->task;
+            if (!t)
+                break;
+            t->dispatchNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - t->grantedAt)
+                                .count();
+            t->work();
+            push(t); // t belongs to the dispatcher from here on
         }
-        return nullptr;
     }
 
-    // Signal a task to run for one time quantum.
-    void runTaskForQuantum(Task *task)
+    void enqueue(Task *t, bool ranBefore)
     {
+        if (schedType == PRIORITY)
+            byPriority.push(t);
+        else if (schedType == FCFS && ranBefore)
+            ready.push_front(t); // keeps the CPU until it finishes
+        else
+            ready.push_back(t);
+    }
+
+    // Choose next task based on scheduling algorithm.
+    Task *selectTask()
+    {
+        Task *t = nullptr;
+        if (schedType == PRIORITY)
         {
-            std::unique_lock<std::mutex> lock(task->mtx);
-            task->run_flag = true;
-            task->cv.notify_one();
+            if (!byPriority.empty())
+            {
+                t = byPriority.top();
+                byPriority.pop();
+            }
         }
-        // std::this_thread::sleep_for(std::chrono::milliseconds(TIME_QUANTUM_MS));
+        else if (!ready.empty())
         {
-            std::unique_lock<std::mutex> lock(task->mtx);
-            task->run_flag = false;
+            t = ready.front();
+            ready.pop_front();
         }
+        return t;
+    }
+
+    // Run a task for one time quantum on an idle worker.
+    void runTaskForQuantum(Task *task, Worker &w, int index)
+    {
+        ++task->dispatchCount;
+        publish(task, THREAD_RUNNING);
+        task->worker = index;
+        task->grantedAt = std::chrono::steady_clock::now();
+        w.task = task;
+        w.parker.unpark();
     }
 
     // Adjust the dynamic priority based on CPU time.
@@ -219,74 +577,131 @@ private:
         int newPriority = task->basePriority - (task->cpuTime / FEEDBACK_FACTOR);
         if (newPriority < 1)
             newPriority = 1;
-        std::cout << "[Scheduler] Adjusting Task " << task->id
-                  << " priority from " << task->dynamicPriority
-                  << " to " << newPriority << "\n";
+        // one write, as the workers print at the same time
+        std::ostringstream line;
+        line << "[Scheduler] Adjusting Task " << task->id
+             << " priority from " << task->dynamicPriority
+             << " to " << newPriority << "\n";
+        std::cout << line.str();
         task->dynamicPriority = newPriority;
     }
 };
 
-// ------------------------------
-// Global scheduler engine instance pointer.
-// ------------------------------
-SchedulerEngine *gScheduler = nullptr;
-
 // ------------------------------
 // Exported C functions (for Python binding)
 // ------------------------------
+// Every engine is an opaque handle from scheduler_create(), independent of
+// the others: its own tasks, dispatcher state and state table, so one
+// process can run many engines at once, each from its own thread. Calls
+// on one handle may come from any thread, except that scheduler_destroy()
+// must not race with anything else on that handle.
 extern "C"
 {
 
-    // Initialize the scheduler with a given algorithm.
-    // type: 0 = FCFS, 1 = RR, 2 = PRIORITY.
-    void init_scheduler(int type)
+    // Create an engine. type: 0 = FCFS, 1 = RR, 2 = PRIORITY.
+    SchedulerEngine *scheduler_create(int type)
     {
         SchedulerType schedType = RR;
         if (type == 0)
             schedType = FCFS;
         else if (type == 2)
             schedType = PRIORITY;
-        gScheduler = new SchedulerEngine(schedType);
+        return new SchedulerEngine(schedType);
+    }
+
+    // Free the engine and all its tasks.
+    void scheduler_destroy(SchedulerEngine *engine)
+    {
+        delete engine;
     }
 
     // Add a task with id, base priority, and burst (in time quanta)
+    void scheduler_add_thread(SchedulerEngine *engine, int thread_id, int base_priority, int burst_quanta)
+    {
+        if (engine)
+            engine->addTask(thread_id, base_priority, burst_quanta);
+    }
+
+    // Worker threads for the next scheduler_run; 0 (the default) means one
+    // per hardware thread.
+    void scheduler_set_workers(SchedulerEngine *engine, int workers)
+    {
+        if (engine)
+            engine->setWorkers(workers);
+    }
+
+    // Run the engine on the calling thread until all its tasks finish.
+    void scheduler_run(SchedulerEngine *engine)
+    {
+        if (engine)
+            engine->run();
+    }
+
+    // Tasks' states as "id,state,dynamicPriority,cpuTime;" per task; the
+    // string is valid until the next call on this engine.
+    const char *scheduler_thread_states(SchedulerEngine *engine)
+    {
+        return engine ? engine->getStates() : "";
+    }
+
+    // Zero-copy task state, valid until scheduler_destroy(). Readers follow
+    // the seqlock protocol described with the record layout.
+    const ThreadStateTable *scheduler_state_table(SchedulerEngine *engine)
+    {
+        return engine ? engine->states() : nullptr;
+    }
+
+    // Copy up to max records into out, each consistent; returns the count.
+    size_t scheduler_copy_thread_states(SchedulerEngine *engine, ThreadStateRecord *out, size_t max)
+    {
+        if (engine == nullptr || out == nullptr)
+            return 0;
+        return engine->copyStates(out, max);
+    }
+
+    // ------------------------------
+    // Single-engine API, kept for existing callers: the same calls on
+    // one process-wide engine.
+    // ------------------------------
+    static SchedulerEngine *gScheduler = nullptr;
+
+    // Initialize the scheduler with a given algorithm.
+    // type: 0 = FCFS, 1 = RR, 2 = PRIORITY.
+    void init_scheduler(int type)
+    {
+        scheduler_destroy(gScheduler);
+        gScheduler = scheduler_create(type);
+    }
+
     void add_thread(int thread_id, int base_priority, int burst_quanta)
     {
-        if (gScheduler == nullptr)
-            return;
-        Task *t = new Task(thread_id, base_priority);
-        // For simulation, set total work as burst_quanta * TIME_QUANTUM_MS.
-        t->remainingWork = burst_quanta * TIME_QUANTUM_MS;
-        gScheduler->addTask(t);
-        gScheduler->registerTask(t); // Keep a record for final reporting.
+        scheduler_add_thread(gScheduler, thread_id, base_priority, burst_quanta);
     }
 
-    // Run the scheduler.
     void run_scheduler()
     {
-        if (gScheduler == nullptr)
-            return;
-        gScheduler->run();
+        scheduler_run(gScheduler);
     }
 
-    // Get the scheduler’s tasks state as a CSV string.
-    // Format per task: "id,state,dynamicPriority,cpuTime;"
     const char *get_thread_states()
     {
-        static std::string out;
-        if (gScheduler == nullptr)
-            return "";
-        out = gScheduler->getStates();
-        return out.c_str();
+        return scheduler_thread_states(gScheduler);
+    }
+
+    const ThreadStateTable *get_thread_state_table()
+    {
+        return scheduler_state_table(gScheduler);
+    }
+
+    size_t copy_thread_states(ThreadStateRecord *out, size_t max)
+    {
+        return scheduler_copy_thread_states(gScheduler, out, max);
     }
 
     // Clean up the scheduler instance.
     void cleanup_scheduler()
     {
-        if (gScheduler)
-        {
-            delete gScheduler;
-            gScheduler = nullptr;
-        }
+        scheduler_destroy(gScheduler);
+        gScheduler = nullptr;
     }
 } // extern "C"
@@ -4,3 +4,32 @@ GanttWidget::GanttWidget(QWidget *parent) : QGraphicsView(parent) {
     scene = new QGraphicsScene(this);
     setScene(scene);
 }
+
+void GanttWidget::drawTimeline(const TimelineReader &timeline, const QString &title) {
+    beginTimeline(title);
+    timeline.for_each([this](const TimelineEntry &e) {
+        addSlice(e.id, e.start_time, e.end_time);
+    });
+    finishTimeline();
+}
+
+static const int offsetY = 30, rowH = 25;
+
+void GanttWidget::beginTimeline(const QString &title) {
+    scene->clear();
+    scene->addText(title)->setPos(0, 0);
+    rows.clear();
+    nextRow = 0;
+}
+
+void GanttWidget::addSlice(int id, int start, int end) {
+    if (!rows.contains(id)) rows[id] = nextRow++;
+    int r = rows[id];
+    int x = start, w = end - start;
+    scene->addRect(x, offsetY + r * rowH, w, 20, QPen(), QBrush(Qt::cyan));
+    scene->addSimpleText(QString("T%1").arg(id))->setPos(x + 2, offsetY + r * rowH);
+}
+
+void GanttWidget::finishTimeline() {
+    scene->setSceneRect(0, 0, 800, offsetY + nextRow * rowH + 50);
+}
@@ -11,6 +11,7 @@
 #include <vector>
 #include <QPen>
 #include <QBrush>
+#include "timeline_store.h"
 
 class GanttWidget : public QGraphicsView {
     Q_OBJECT
@@ -20,24 +21,23 @@ public:
 
     template <typename T>
     void drawTimeline(const std::vector<T> &timeline, const QString &title) {
-        scene->clear();
-        scene->addText(title)->setPos(0, 0);
-
-        int offsetY = 30, rowH = 25;
-        QMap<int, int> rows;
-        int nextRow = 0;
-        for (auto &e : timeline) {
-            if (!rows.contains(e.id)) rows[e.id] = nextRow++;
-            int r = rows[e.id];
-            int x = e.start_time, w = e.end_time - e.start_time;
-            scene->addRect(x, offsetY + r * rowH, w, 20, QPen(), QBrush(Qt::cyan));
-            scene->addSimpleText(QString("T%1").arg(e.id))->setPos(x + 2, offsetY + r * rowH);
-        }
-        scene->setSceneRect(0, 0, 800, offsetY + nextRow * rowH + 50);
+        beginTimeline(title);
+        for (auto &e : timeline)
+            addSlice(e.id, e.start_time, e.end_time);
+        finishTimeline();
     }
 
+    // draw a timeline file, decoding one chunk at a time
+    void drawTimeline(const TimelineReader &timeline, const QString &title);
+
 private:
+    void beginTimeline(const QString &title);
+    void addSlice(int id, int start, int end);
+    void finishTimeline();
+
     QGraphicsScene *scene;
+    QMap<int, int> rows;
+    int nextRow = 0;
 };
 
 #endif // GANTTWIDGET_H
\ No newline at end of file
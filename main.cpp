@@ -1,26 +1,22 @@
 // main.cpp
 
-#include <windows.h>         
 #include <QApplication>
 #include <QDebug>
 #include "mainwindow.h"
-
-extern LPVOID scheduler_fiber;
+#include "ult_context.h"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    scheduler_fiber = ConvertThreadToFiber(nullptr);
+    scheduler_fiber = ult_convert_thread();
     if (!scheduler_fiber) {
-        qFatal("ConvertThreadToFiber failed, error %u", GetLastError());
+        qFatal("ult_convert_thread failed");
         return -1;
     }
     MainWindow w;
     w.show();
     int result = a.exec();
-    if (!ConvertFiberToThread()) {
-        qWarning() << "ConvertFiberToThread failed, error" << GetLastError();
-    }
+    ult_convert_back();
 
     return result;
 }
@@ -0,0 +1,220 @@
+// Scalar, AVX2 and AVX-512 argmin kernels with runtime dispatch.
+// The SIMD versions keep one running minimum and its position per lane
+// (a strict less-than, so every lane keeps its first minimum), then reduce
+// the lanes at the end, preferring the lower position on ties. The x86
+// paths need GCC or Clang for per-function target attributes; other
+// compilers and CPUs get the scalar kernels only.
+#include "pick_kernels.h"
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PICK_HAVE_X86 1
+#include <immintrin.h>
+#else
+#define PICK_HAVE_X86 0
+#endif
+
+namespace {
+
+template <typename T>
+std::size_t argmin_scalar(const T *keys, std::size_t n, std::size_t from = 0, std::size_t best = 0) {
+    for (std::size_t i = from; i < n; ++i)
+        if (keys[i] < keys[best]) best = i;
+    return best;
+}
+
+// lane reduction: lowest key, then lowest position
+template <typename T, std::size_t L>
+std::size_t reduce_lanes(const T (&key)[L], const std::int64_t (&pos)[L]) {
+    std::size_t b = 0;
+    for (std::size_t l = 1; l < L; ++l)
+        if (key[l] < key[b] || (key[l] == key[b] && pos[l] < pos[b])) b = l;
+    return static_cast<std::size_t>(pos[b]);
+}
+
+#if PICK_HAVE_X86
+
+// Each kernel runs four independent accumulators, so the compare/blend
+// chains of consecutive vectors overlap instead of serialising.
+
+__attribute__((target("avx2")))
+std::size_t argmin_i64_avx2(const std::int64_t *keys, std::size_t n) {
+    if (n < 32) return argmin_scalar(keys, n);
+    __m256i vmin[4], vpos[4];
+    const __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+    for (int a = 0; a < 4; ++a) {
+        vmin[a] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + 4 * a));
+        vpos[a] = _mm256_add_epi64(lane, _mm256_set1_epi64x(4 * a));
+    }
+    std::size_t i = 16;
+    for (; i + 16 <= n; i += 16) {
+        for (int a = 0; a < 4; ++a) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i + 4 * a));
+            __m256i lt = _mm256_cmpgt_epi64(vmin[a], v);
+            __m256i cur = _mm256_add_epi64(lane, _mm256_set1_epi64x(static_cast<long long>(i + 4 * a)));
+            vmin[a] = _mm256_blendv_epi8(vmin[a], v, lt);
+            vpos[a] = _mm256_blendv_epi8(vpos[a], cur, lt);
+        }
+    }
+    alignas(32) std::int64_t k[16], p[16];
+    for (int a = 0; a < 4; ++a) {
+        _mm256_store_si256(reinterpret_cast<__m256i *>(k + 4 * a), vmin[a]);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(p + 4 * a), vpos[a]);
+    }
+    return argmin_scalar(keys, n, i, reduce_lanes(k, p));
+}
+
+__attribute__((target("avx2")))
+std::size_t argmin_f64_avx2(const double *keys, std::size_t n) {
+    if (n < 32) return argmin_scalar(keys, n);
+    __m256d vmin[4];
+    __m256i vpos[4];
+    const __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+    for (int a = 0; a < 4; ++a) {
+        vmin[a] = _mm256_loadu_pd(keys + 4 * a);
+        vpos[a] = _mm256_add_epi64(lane, _mm256_set1_epi64x(4 * a));
+    }
+    std::size_t i = 16;
+    for (; i + 16 <= n; i += 16) {
+        for (int a = 0; a < 4; ++a) {
+            __m256d v = _mm256_loadu_pd(keys + i + 4 * a);
+            __m256d lt = _mm256_cmp_pd(v, vmin[a], _CMP_LT_OQ);
+            __m256i cur = _mm256_add_epi64(lane, _mm256_set1_epi64x(static_cast<long long>(i + 4 * a)));
+            vmin[a] = _mm256_blendv_pd(vmin[a], v, lt);
+            vpos[a] = _mm256_blendv_epi8(vpos[a], cur, _mm256_castpd_si256(lt));
+        }
+    }
+    alignas(32) double k[16];
+    alignas(32) std::int64_t p[16];
+    for (int a = 0; a < 4; ++a) {
+        _mm256_store_pd(k + 4 * a, vmin[a]);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(p + 4 * a), vpos[a]);
+    }
+    return argmin_scalar(keys, n, i, reduce_lanes(k, p));
+}
+
+__attribute__((target("avx512f")))
+std::size_t argmin_i64_avx512(const std::int64_t *keys, std::size_t n) {
+    if (n < 64) return argmin_scalar(keys, n);
+    __m512i vmin[4], vpos[4];
+    const __m512i lane = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int a = 0; a < 4; ++a) {
+        vmin[a] = _mm512_loadu_si512(keys + 8 * a);
+        vpos[a] = _mm512_add_epi64(lane, _mm512_set1_epi64(8 * a));
+    }
+    std::size_t i = 32;
+    for (; i + 32 <= n; i += 32) {
+        for (int a = 0; a < 4; ++a) {
+            __m512i v = _mm512_loadu_si512(keys + i + 8 * a);
+            __mmask8 lt = _mm512_cmplt_epi64_mask(v, vmin[a]);
+            __m512i cur = _mm512_add_epi64(lane, _mm512_set1_epi64(static_cast<long long>(i + 8 * a)));
+            vmin[a] = _mm512_mask_mov_epi64(vmin[a], lt, v);
+            vpos[a] = _mm512_mask_mov_epi64(vpos[a], lt, cur);
+        }
+    }
+    alignas(64) std::int64_t k[32], p[32];
+    for (int a = 0; a < 4; ++a) {
+        _mm512_store_si512(k + 8 * a, vmin[a]);
+        _mm512_store_si512(p + 8 * a, vpos[a]);
+    }
+    return argmin_scalar(keys, n, i, reduce_lanes(k, p));
+}
+
+__attribute__((target("avx512f")))
+std::size_t argmin_f64_avx512(const double *keys, std::size_t n) {
+    if (n < 64) return argmin_scalar(keys, n);
+    __m512d vmin[4];
+    __m512i vpos[4];
+    const __m512i lane = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int a = 0; a < 4; ++a) {
+        vmin[a] = _mm512_loadu_pd(keys + 8 * a);
+        vpos[a] = _mm512_add_epi64(lane, _mm512_set1_epi64(8 * a));
+    }
+    std::size_t i = 32;
+    for (; i + 32 <= n; i += 32) {
+        for (int a = 0; a < 4; ++a) {
+            __m512d v = _mm512_loadu_pd(keys + i + 8 * a);
+            __mmask8 lt = _mm512_cmp_pd_mask(v, vmin[a], _CMP_LT_OQ);
+            __m512i cur = _mm512_add_epi64(lane, _mm512_set1_epi64(static_cast<long long>(i + 8 * a)));
+            vmin[a] = _mm512_mask_mov_pd(vmin[a], lt, v);
+            vpos[a] = _mm512_mask_mov_epi64(vpos[a], lt, cur);
+        }
+    }
+    alignas(64) double k[32];
+    alignas(64) std::int64_t p[32];
+    for (int a = 0; a < 4; ++a) {
+        _mm512_store_pd(k + 8 * a, vmin[a]);
+        _mm512_store_si512(p + 8 * a, vpos[a]);
+    }
+    return argmin_scalar(keys, n, i, reduce_lanes(k, p));
+}
+
+#endif // PICK_HAVE_X86
+
+bool cpu_has(PickIsa isa) {
+    switch (isa) {
+    case PICK_ISA_SCALAR:
+        return true;
+#if PICK_HAVE_X86
+    case PICK_ISA_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case PICK_ISA_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+PickIsa detect() {
+#if PICK_HAVE_X86
+    __builtin_cpu_init();   // we run from a static initializer
+#endif
+    if (cpu_has(PICK_ISA_AVX512)) return PICK_ISA_AVX512;
+    if (cpu_has(PICK_ISA_AVX2)) return PICK_ISA_AVX2;
+    return PICK_ISA_SCALAR;
+}
+
+std::atomic<int> g_isa{detect()};
+
+} // namespace
+
+PickIsa pick_isa() {
+    return static_cast<PickIsa>(g_isa.load(std::memory_order_relaxed));
+}
+
+bool pick_set_isa(PickIsa isa) {
+    if (!cpu_has(isa)) return false;
+    g_isa.store(isa, std::memory_order_relaxed);
+    return true;
+}
+
+const char *pick_isa_name(PickIsa isa) {
+    switch (isa) {
+    case PICK_ISA_AVX2: return "avx2";
+    case PICK_ISA_AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+std::size_t pick_argmin(const std::int64_t *keys, std::size_t n) {
+#if PICK_HAVE_X86
+    switch (pick_isa()) {
+    case PICK_ISA_AVX512: return argmin_i64_avx512(keys, n);
+    case PICK_ISA_AVX2: return argmin_i64_avx2(keys, n);
+    default: break;
+    }
+#endif
+    return argmin_scalar(keys, n);
+}
+
+std::size_t pick_argmin(const double *keys, std::size_t n) {
+#if PICK_HAVE_X86
+    switch (pick_isa()) {
+    case PICK_ISA_AVX512: return argmin_f64_avx512(keys, n);
+    case PICK_ISA_AVX2: return argmin_f64_avx2(keys, n);
+    default: break;
+    }
+#endif
+    return argmin_scalar(keys, n);
+}
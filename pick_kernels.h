@@ -0,0 +1,104 @@
+#ifndef PICK_KERNELS_H
+#define PICK_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pick-next kernels for the scan-based policies.
+// pick_argmin() returns the position of the smallest key in keys[0, n),
+// the first one on ties, using the widest instruction set the CPU has
+// (AVX-512, AVX2 or plain scalar code). The choice is made once at startup
+// and can be forced with pick_set_isa(), e.g. to benchmark the fallback.
+
+enum PickIsa {
+    PICK_ISA_SCALAR,
+    PICK_ISA_AVX2,
+    PICK_ISA_AVX512
+};
+
+PickIsa pick_isa();
+bool pick_set_isa(PickIsa isa);     // false if the CPU lacks it
+const char *pick_isa_name(PickIsa isa);
+
+std::size_t pick_argmin(const std::int64_t *keys, std::size_t n);
+std::size_t pick_argmin(const double *keys, std::size_t n);
+
+// How a policy keeps its ready set: an ordered queue (heap or tree,
+// O(log n) per pick) or a dense key array scanned by pick_argmin (O(n), but
+// branch-free and vectorised). On scheduler_bench's workloads the scan only
+// beats the 4-ary heap for the smallest runs, so AUTO switches early.
+enum PickMode {
+    PICK_AUTO,      // scan if the run has at most PICK_SCAN_MAX tasks
+    PICK_QUEUE,
+    PICK_SCAN
+};
+
+static const std::size_t PICK_SCAN_MAX = 128;
+
+inline PickMode pick_resolve(PickMode mode, std::size_t tasks) {
+    if (mode != PICK_AUTO) return mode;
+    return tasks <= PICK_SCAN_MAX ? PICK_SCAN : PICK_QUEUE;
+}
+
+// (major, minor) packed into one int64 that orders the same way, so a
+// two-part key can go through the int64 kernel; minor is compared as a
+// signed 32-bit value
+inline std::int64_t pick_pack(std::int64_t major, std::int32_t minor) {
+    return major * 4294967296LL + static_cast<std::int64_t>(static_cast<std::uint32_t>(minor) ^ 0x80000000u);
+}
+
+inline std::int64_t pick_major(std::int64_t key) {
+    return (key - (key & 0xffffffffLL)) / 4294967296LL;
+}
+
+// Ready set as two parallel arrays: keys for the kernel, handles alongside.
+// Removal swaps the last element into the hole, so positions are not
+// stable; ties between equal keys go to whichever sits first.
+template <typename Key>
+class ScanQueue {
+public:
+    typedef std::uint32_t Handle;
+
+    explicit ScanQueue(std::size_t capacity = 0) {
+        keys.reserve(capacity);
+        handles.reserve(capacity);
+    }
+
+    bool empty() const { return keys.empty(); }
+    std::size_t size() const { return keys.size(); }
+
+    void push(Handle h, const Key &k) {
+        keys.push_back(k);
+        handles.push_back(h);
+        best = NONE;
+    }
+
+    Handle top() { return handles[find()]; }
+    const Key &top_key() { return keys[find()]; }
+
+    Handle pop() {
+        std::size_t i = find();
+        Handle h = handles[i];
+        keys[i] = keys.back();
+        keys.pop_back();
+        handles[i] = handles.back();
+        handles.pop_back();
+        best = NONE;
+        return h;
+    }
+
+private:
+    static const std::size_t NONE = static_cast<std::size_t>(-1);
+
+    std::size_t find() {
+        if (best == NONE) best = pick_argmin(keys.data(), keys.size());
+        return best;
+    }
+
+    std::vector<Key> keys;
+    std::vector<Handle> handles;
+    std::size_t best = NONE;    // cached position of the minimum
+};
+
+#endif // PICK_KERNELS_H
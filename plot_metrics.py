@@ -5,22 +5,32 @@ import matplotlib.pyplot as plt
 # Read data
 algos = []
 resp, tat, wait = [], [], []
+resp_ci, tat_ci, wait_ci = [], [], []
 with open('metrics.csv', newline='') as csvfile:
-    reader = csv.DictReader(csvfile)
-    for row in reader:
-        algos.append(row['Algorithm'])
-        resp.append(float(row['Response']))
-        tat.append(float(row['Turnaround']))
-        wait.append(float(row['Waiting']))
+    rows = list(csv.DictReader(csvfile))
+# sweeps over several quanta / sizes get one bar group per cell
+cells = {(row.get('Quantum'), row.get('Tasks')) for row in rows}
+for row in rows:
+    label = row['Algorithm']
+    if len(cells) > 1:
+        label += ' q=%s n=%s' % (row['Quantum'], row['Tasks'])
+    algos.append(label)
+    resp.append(float(row['Response']))
+    tat.append(float(row['Turnaround']))
+    wait.append(float(row['Waiting']))
+    # 95% confidence half-widths, when the sweep wrote them
+    resp_ci.append(float(row.get('Response_CI') or 0))
+    tat_ci.append(float(row.get('Turnaround_CI') or 0))
+    wait_ci.append(float(row.get('Waiting_CI') or 0))
 
 # Positions for each group
 x = range(len(algos))
 width = 0.25
 
 plt.figure(figsize=(10,6))
-plt.bar([p - width for p in x], resp, width, label='Response')
-plt.bar(x,               tat, width, label='Turnaround')
-plt.bar([p + width for p in x], wait, width, label='Waiting')
+plt.bar([p - width for p in x], resp, width, yerr=resp_ci, capsize=3, label='Response')
+plt.bar(x,               tat, width, yerr=tat_ci, capsize=3, label='Turnaround')
+plt.bar([p + width for p in x], wait, width, yerr=wait_ci, capsize=3, label='Waiting')
 
 plt.xticks(x, algos, rotation=45, ha='right')
 plt.ylabel('Time (units)')
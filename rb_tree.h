@@ -0,0 +1,252 @@
+#ifndef RB_TREE_H
+#define RB_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// links embedded in the record that lives in the tree
+struct RBLinks {
+    std::uint32_t parent;
+    std::uint32_t left;
+    std::uint32_t right;
+    bool red;
+};
+
+// Intrusive red-black tree over dense 32-bit handles, in the style of the
+// kernel's rb_root_cached: the node links live inside the caller's records,
+// so insert/erase never allocate, and the leftmost node is cached so the
+// minimum is O(1). Ops supplies
+//     RBLinks& links(Handle h);
+//     bool     less(Handle a, Handle b);   // strict weak order
+template <typename Ops>
+class IntrusiveRBTree {
+public:
+    typedef std::uint32_t Handle;
+    static constexpr Handle NIL = static_cast<Handle>(-1);
+
+    explicit IntrusiveRBTree(Ops o) : ops(o) {}
+
+    bool empty() const { return root == NIL; }
+    std::size_t size() const { return count; }
+    Handle leftmost() const { return first; }
+
+    void insert(Handle z) {
+        Handle y = NIL, x = root;
+        bool is_leftmost = true, went_left = false;
+        while (x != NIL) {
+            y = x;
+            went_left = ops.less(z, x);
+            if (went_left) {
+                x = L(x).left;
+            } else {
+                x = L(x).right;
+                is_leftmost = false;
+            }
+        }
+
+        RBLinks& lz = L(z);
+        lz.parent = y;
+        lz.left = lz.right = NIL;
+        lz.red = true;
+        if (y == NIL) root = z;
+        else if (went_left) L(y).left = z;
+        else L(y).right = z;
+
+        if (is_leftmost) first = z;
+        ++count;
+        insert_fixup(z);
+    }
+
+    void erase(Handle z) {
+        if (z == first)
+            first = (L(z).right != NIL) ? minimum(L(z).right) : L(z).parent;
+
+        Handle y = z, x, x_parent;
+        if (L(z).left == NIL) {
+            x = L(z).right;
+        } else if (L(z).right == NIL) {
+            x = L(z).left;
+        } else {
+            y = minimum(L(z).right);
+            x = L(y).right;
+        }
+
+        if (y != z) {
+            // z has two children: splice its successor y into z's place
+            L(L(z).left).parent = y;
+            L(y).left = L(z).left;
+            if (y != L(z).right) {
+                x_parent = L(y).parent;
+                if (x != NIL) L(x).parent = L(y).parent;
+                L(L(y).parent).left = x;
+                L(y).right = L(z).right;
+                L(L(z).right).parent = y;
+            } else {
+                x_parent = y;
+            }
+            replace_child(z, y);
+            L(y).parent = L(z).parent;
+            std::swap(L(y).red, L(z).red);
+            y = z;      // y is now the node whose colour was removed
+        } else {
+            x_parent = L(y).parent;
+            if (x != NIL) L(x).parent = L(y).parent;
+            replace_child(z, x);
+        }
+
+        --count;
+        if (!L(y).red)
+            erase_fixup(x, x_parent);
+    }
+
+    Handle pop_leftmost() {
+        Handle h = first;
+        erase(h);
+        return h;
+    }
+
+private:
+    RBLinks& L(Handle h) { return ops.links(h); }
+    bool is_red(Handle h) { return h != NIL && L(h).red; }
+
+    Handle minimum(Handle x) {
+        while (L(x).left != NIL) x = L(x).left;
+        return x;
+    }
+
+    // make `with` take old's place under old's parent (or as root)
+    void replace_child(Handle old, Handle with) {
+        Handle p = L(old).parent;
+        if (p == NIL) root = with;
+        else if (L(p).left == old) L(p).left = with;
+        else L(p).right = with;
+    }
+
+    void rotate_left(Handle x) {
+        Handle y = L(x).right;
+        L(x).right = L(y).left;
+        if (L(y).left != NIL) L(L(y).left).parent = x;
+        L(y).parent = L(x).parent;
+        replace_child(x, y);
+        L(y).left = x;
+        L(x).parent = y;
+    }
+
+    void rotate_right(Handle x) {
+        Handle y = L(x).left;
+        L(x).left = L(y).right;
+        if (L(y).right != NIL) L(L(y).right).parent = x;
+        L(y).parent = L(x).parent;
+        replace_child(x, y);
+        L(y).right = x;
+        L(x).parent = y;
+    }
+
+    void insert_fixup(Handle z) {
+        while (z != root && is_red(L(z).parent)) {
+            Handle p = L(z).parent;
+            Handle g = L(p).parent;
+            if (p == L(g).left) {
+                Handle u = L(g).right;
+                if (is_red(u)) {
+                    L(p).red = false;
+                    L(u).red = false;
+                    L(g).red = true;
+                    z = g;
+                } else {
+                    if (z == L(p).right) {
+                        z = p;
+                        rotate_left(z);
+                        p = L(z).parent;
+                    }
+                    L(p).red = false;
+                    L(g).red = true;
+                    rotate_right(g);
+                }
+            } else {
+                Handle u = L(g).left;
+                if (is_red(u)) {
+                    L(p).red = false;
+                    L(u).red = false;
+                    L(g).red = true;
+                    z = g;
+                } else {
+                    if (z == L(p).left) {
+                        z = p;
+                        rotate_right(z);
+                        p = L(z).parent;
+                    }
+                    L(p).red = false;
+                    L(g).red = true;
+                    rotate_left(g);
+                }
+            }
+        }
+        L(root).red = false;
+    }
+
+    void erase_fixup(Handle x, Handle x_parent) {
+        while (x != root && !is_red(x)) {
+            if (x == L(x_parent).left) {
+                Handle w = L(x_parent).right;
+                if (is_red(w)) {
+                    L(w).red = false;
+                    L(x_parent).red = true;
+                    rotate_left(x_parent);
+                    w = L(x_parent).right;
+                }
+                if (!is_red(L(w).left) && !is_red(L(w).right)) {
+                    L(w).red = true;
+                    x = x_parent;
+                    x_parent = L(x_parent).parent;
+                } else {
+                    if (!is_red(L(w).right)) {
+                        L(L(w).left).red = false;
+                        L(w).red = true;
+                        rotate_right(w);
+                        w = L(x_parent).right;
+                    }
+                    L(w).red = L(x_parent).red;
+                    L(x_parent).red = false;
+                    if (L(w).right != NIL) L(L(w).right).red = false;
+                    rotate_left(x_parent);
+                    break;
+                }
+            } else {
+                Handle w = L(x_parent).left;
+                if (is_red(w)) {
+                    L(w).red = false;
+                    L(x_parent).red = true;
+                    rotate_right(x_parent);
+                    w = L(x_parent).left;
+                }
+                if (!is_red(L(w).right) && !is_red(L(w).left)) {
+                    L(w).red = true;
+                    x = x_parent;
+                    x_parent = L(x_parent).parent;
+                } else {
+                    if (!is_red(L(w).left)) {
+                        L(L(w).right).red = false;
+                        L(w).red = true;
+                        rotate_left(w);
+                        w = L(x_parent).left;
+                    }
+                    L(w).red = L(x_parent).red;
+                    L(x_parent).red = false;
+                    if (L(w).left != NIL) L(L(w).left).red = false;
+                    rotate_right(x_parent);
+                    break;
+                }
+            }
+        }
+        if (x != NIL) L(x).red = false;
+    }
+
+    Ops ops;
+    Handle root = NIL;
+    Handle first = NIL;     // cached leftmost
+    std::size_t count = 0;
+};
+
+#endif // RB_TREE_H
@@ -0,0 +1,133 @@
+#ifndef RUN_QUEUE_H
+#define RUN_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Indexed d-ary min-heap used as the run queue of the key-ordered policies.
+// Elements are dense task handles (0..n-1) stored next to their key in one
+// flat array, plus a handle -> slot map so a queued task's key can be changed
+// in O(log_d n) (decrease-key / increase-key) or removed without a search.
+// With D = 4 a node's children share a cache line, and the tree is half as
+// deep as a binary heap.
+template <typename Key, unsigned D = 4>
+class IndexedDaryHeap {
+public:
+    typedef std::uint32_t Handle;
+    static constexpr Handle NPOS = static_cast<Handle>(-1);
+
+    explicit IndexedDaryHeap(std::size_t capacity = 0) { reserve(capacity); }
+
+    void reserve(std::size_t n) {
+        heap.reserve(n);
+        if (pos.size() < n) pos.resize(n, NPOS);
+    }
+
+    bool empty() const { return heap.empty(); }
+    std::size_t size() const { return heap.size(); }
+
+    bool contains(Handle h) const { return h < pos.size() && pos[h] != NPOS; }
+
+    Handle top() const { return heap.front().handle; }
+    const Key& top_key() const { return heap.front().key; }
+    const Key& key(Handle h) const { return heap[pos[h]].key; }
+
+    void push(Handle h, const Key& k) {
+        if (h >= pos.size()) pos.resize(static_cast<std::size_t>(h) + 1, NPOS);
+        heap.push_back(Node{ k, h });
+        pos[h] = static_cast<Handle>(heap.size() - 1);
+        sift_up(heap.size() - 1);
+    }
+
+    Handle pop() {
+        Handle h = heap.front().handle;
+        remove_at(0);
+        return h;
+    }
+
+    // change the key of a queued handle, in either direction
+    void update(Handle h, const Key& k) {
+        std::size_t i = pos[h];
+        bool up = k < heap[i].key;
+        heap[i].key = k;
+        if (up) sift_up(i);
+        else sift_down(i);
+    }
+
+    void erase(Handle h) { remove_at(pos[h]); }
+
+    void clear() {
+        for (auto& n : heap) pos[n.handle] = NPOS;
+        heap.clear();
+    }
+
+    // Visit every queued (handle, key) in storage order. f may modify the key,
+    // but only in a way that keeps the relative order of all keys (e.g. the
+    // same shift applied to every element).
+    template <typename F>
+    void for_each(F f) {
+        for (auto& n : heap) f(n.handle, n.key);
+    }
+
+private:
+    struct Node {
+        Key key;
+        Handle handle;
+    };
+
+    void place(std::size_t i, Node&& n) {
+        pos[n.handle] = static_cast<Handle>(i);
+        heap[i] = std::move(n);
+    }
+
+    void remove_at(std::size_t i) {
+        pos[heap[i].handle] = NPOS;
+        Node last = std::move(heap.back());
+        heap.pop_back();
+        if (i == heap.size()) return;
+
+        bool up = i > 0 && last.key < heap[(i - 1) / D].key;
+        place(i, std::move(last));
+        if (up) sift_up(i);
+        else sift_down(i);
+    }
+
+    void sift_up(std::size_t i) {
+        Node n = std::move(heap[i]);
+        while (i > 0) {
+            std::size_t parent = (i - 1) / D;
+            if (!(n.key < heap[parent].key)) break;
+            place(i, std::move(heap[parent]));
+            i = parent;
+        }
+        place(i, std::move(n));
+    }
+
+    void sift_down(std::size_t i) {
+        const std::size_t n = heap.size();
+        Node node = std::move(heap[i]);
+        while (true) {
+            std::size_t first = i * D + 1;
+            if (first >= n) break;
+            std::size_t last = first + D < n ? first + D : n;
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < last; ++c)
+                if (heap[c].key < heap[best].key) best = c;
+            if (!(heap[best].key < node.key)) break;
+            place(i, std::move(heap[best]));
+            i = best;
+        }
+        place(i, std::move(node));
+    }
+
+    std::vector<Node> heap;
+    std::vector<Handle> pos;   // handle -> slot in heap, NPOS if not queued
+};
+
+// run queue of the key-ordered Scheduler policies
+template <typename Key>
+using RunQueue = IndexedDaryHeap<Key, 4>;
+
+#endif // RUN_QUEUE_H
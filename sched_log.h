@@ -0,0 +1,84 @@
+#ifndef SCHED_LOG_H
+#define SCHED_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Level-gated scheduler logging.
+// Hot loops record fixed-size binary events instead of building strings;
+// the owner formats them in batches when its ring fills up, before any
+// plain-text message, and at the end of a run. A statement guarded by
+// SCHED_LOG_ON costs one branch when the level is disabled at runtime and
+// compiles away entirely when it is above SCHED_LOG_MAX_LEVEL
+// (e.g. -DSCHED_LOG_MAX_LEVEL=2 keeps only errors and start/done lines).
+
+enum LogLevel {
+    LOG_OFF = 0,
+    LOG_ERROR = 1,
+    LOG_INFO = 2,     // run start/done, summaries
+    LOG_DEBUG = 3,    // one line per slice
+    LOG_TRACE = 4     // per-worker detail
+};
+
+#ifndef SCHED_LOG_MAX_LEVEL
+#define SCHED_LOG_MAX_LEVEL 4
+#endif
+
+#define SCHED_LOG_ON(lvl, runtime_level) \
+    ((lvl) <= SCHED_LOG_MAX_LEVEL && (lvl) <= (runtime_level))
+
+// one log record; `kind` selects the owner's format string
+struct LogEvent {
+    std::uint16_t kind;
+    std::int32_t id;
+    std::int32_t start;
+    std::int32_t end;
+    std::int32_t arg;
+    double value;
+};
+
+// Single-producer / single-consumer ring of LogEvents. The producer only
+// writes `head` and the consumer only writes `tail`, so neither side locks;
+// the two may be the same thread.
+class EventLog {
+public:
+    explicit EventLog(std::size_t capacity = 4096) {
+        std::size_t n = 1;
+        while (n < capacity) n <<= 1;
+        ring.resize(n);
+        mask = n - 1;
+    }
+
+    // producer: false if the ring is full
+    bool push(const LogEvent &ev) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) return false;
+        ring[h & mask] = ev;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer: hand every queued event to f(const LogEvent&), oldest first
+    template <typename F>
+    std::size_t drain(F f) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t h = head.load(std::memory_order_acquire);
+        for (std::size_t i = t; i != h; ++i) f(ring[i & mask]);
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<LogEvent> ring;
+    std::size_t mask = 0;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+};
+
+#endif // SCHED_LOG_H
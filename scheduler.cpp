@@ -3,13 +3,19 @@
 #include <chrono>
 #include <algorithm>
 #include <iostream>
-#include <set>
 #include <deque>
 #include <vector>
-#include <unordered_map>
 #include <queue>
 #include <functional>
 #include <string>
+#include <utility>
+#include <cstdint>
+#include <cstdio>
+#include "pick_kernels.h"
+#include "run_queue.h"
+#include "workload.h"
+#include "timeline_store.h"
+#include "sim_kernel.h"
 
 using namespace std;
 
@@ -24,14 +30,114 @@ Scheduler::Scheduler(Algorithm algo, int tq, function<void(const string &)> lg)
         {4, 21, 150, 500, 700, 0}};
 }
 
-void Scheduler::log(const string &msg)
+Scheduler::~Scheduler() = default;
+
+void Scheduler::setWorkload(unique_ptr<WorkloadSource> source)
+{
+    workload = std::move(source);
+}
+
+namespace
 {
+
+// per-slice event kinds, one per policy
+enum SliceEvent : std::uint16_t
+{
+    EV_FCFS,
+    EV_RR,
+    EV_PR,
+    EV_SJF,
+    EV_MLQ,
+    EV_MLFQ,
+    EV_EDF,
+    EV_CFS
+};
+
+string formatEvent(const LogEvent &ev)
+{
+    char buf[128];
+    switch (ev.kind)
+    {
+    case EV_FCFS:
+        snprintf(buf, sizeof(buf), "[FCFS] T%d %d->%d", ev.id, ev.start, ev.end);
+        break;
+    case EV_RR:
+        snprintf(buf, sizeof(buf), "[RR] T%d %d->%d", ev.id, ev.start, ev.end);
+        break;
+    case EV_PR:
+        snprintf(buf, sizeof(buf), "[PR ] T%d pr=%d %d->%d", ev.id, ev.arg, ev.start, ev.end);
+        break;
+    case EV_SJF:
+        snprintf(buf, sizeof(buf), "[SJF] T%d %d->%d", ev.id, ev.start, ev.end);
+        break;
+    case EV_MLQ:
+        snprintf(buf, sizeof(buf), "[MLQ] T%d pr=%d %d->%d", ev.id, ev.arg, ev.start, ev.end);
+        break;
+    case EV_MLFQ:
+        snprintf(buf, sizeof(buf), "[MLFQ] T%d L%d %d->%d", ev.id, ev.arg, ev.start, ev.end);
+        break;
+    case EV_EDF:
+        snprintf(buf, sizeof(buf), "[EDF] T%d dl=%d %d->%d", ev.id, ev.arg, ev.start, ev.end);
+        break;
+    case EV_CFS:
+        snprintf(buf, sizeof(buf), "[CFS] T%d vruntime=%f %d->%d", ev.id, ev.value, ev.start, ev.end);
+        break;
+    default:
+        snprintf(buf, sizeof(buf), "[?] event %u", unsigned(ev.kind));
+        break;
+    }
+    return buf;
+}
+
+} // namespace
+
+void Scheduler::log(const string &msg, LogLevel level)
+{
+    if (level > log_level)
+        return;
+    flushLog();
     if (logger)
         logger(msg);
     else
         cout << msg << "\n";
 }
 
+void Scheduler::trace(std::uint16_t kind, int id, int start, int end, int arg, double value)
+{
+    LogEvent ev = {kind, id, start, end, arg, value};
+    if (!events.push(ev))
+    {
+        flushLog();
+        events.push(ev);
+    }
+}
+
+// format queued events in one batch, off the scheduling loop
+void Scheduler::flushLog()
+{
+    events.drain([this](const LogEvent &ev)
+                 {
+                     string line = formatEvent(ev);
+                     if (logger)
+                         logger(line);
+                     else
+                         cout << line << "\n";
+                 });
+}
+
+void Scheduler::setTimelineOutput(TimelineWriter *out)
+{
+    timeline_out = out;
+}
+
+void Scheduler::record(int id, int start, int end)
+{
+    if (timeline_out)
+        timeline_out->append(id, start, end);
+    else
+        _timeline.push_back({id, start, end});
+}
+
 const vector<TimelineEntry> &Scheduler::timeline() const
 {
     return _timeline;
@@ -39,6 +145,7 @@ const vector<TimelineEntry> &Scheduler::timeline() const
 
 void Scheduler::run()
 {
+    workload_error.clear();
     switch (algorithm)
     {
     case FCFS:
@@ -66,502 +173,340 @@ void Scheduler::run()
         runCFS();
         break;
     }
+
+    if (workload)
+    {
+        workload_error = workload->error();
+        if (!workload_error.empty())
+            log("[WL] " + workload_error, LOG_ERROR);
+        workload.reset();
+    }
+    flushLog();
 }
 
-void Scheduler::runFCFS()
+namespace
 {
-    log("[FCFS] Starting");
-    int t = 0;
-    for (auto &tk : tasks)
-    {
-        int s = std::max(t, tk.arrival_time);
-        int e = s + tk.remaining_time;
 
-        _timeline.push_back({tk.id, s, e});
-        log("[FCFS] T" + std::to_string(tk.id) + " " + std::to_string(s) + "->" + std::to_string(e));
+typedef TaskTable::Handle Handle;
 
-        // std::this_thread::sleep_for(std::chrono::milliseconds(tk.remaining_time / 10));
-        t = e;
-    }
-    log("[FCFS] Done");
-}
+// The policies below only keep a ready set; the clock, arrivals and the
+// dispatch loop are SimKernel's (sim_kernel.h).
 
-void Scheduler::runRR()
+struct FCFSPolicy : SimPolicy
 {
-    log("[RR] Starting");
+    std::deque<Handle> rq;
 
-    int t = 0;             // current time
-    std::deque<Task *> rq; // ready queue
-    size_t next = 0;       // index of next task to arrive
+    explicit FCFSPolicy(Scheduler &s) : SimPolicy(s) {}
 
-    // we initialize the ready queue with tasks arriving at time 0
-    while (next < tasks.size() && tasks[next].arrival_time <= t)
-    {
-        rq.push_back(&tasks[next++]);
-    }
+    bool empty() const { return rq.empty(); }
+    void enqueue(Handle h) { rq.push_back(h); }
 
-    while (!rq.empty() || next < tasks.size())
+    Handle pick()
     {
-        if (rq.empty())
-        {
-            t = tasks[next].arrival_time;
-            rq.push_back(&tasks[next++]);
-        }
-
-        Task *tk = rq.front();
+        Handle h = rq.front();
         rq.pop_front();
-        int s = std::max(t, tk->arrival_time);
-        int run = std::min(tk->remaining_time, time_quantum);
-        int e = s + run;
+        return h;
+    }
 
-        _timeline.push_back({tk->id, s, e});
-        log("[RR] T" + std::to_string(tk->id) + " " + std::to_string(s) + "->" + std::to_string(e));
+    void on_tick(Handle h, int s, int e)
+    {
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_FCFS, table.id[h], s, e);
+    }
+};
 
-        // std::this_thread::sleep_for(std::chrono::milliseconds(run / 10));
+// FCFS with every slice capped at the quantum
+struct RRPolicy : FCFSPolicy
+{
+    explicit RRPolicy(Scheduler &s) : FCFSPolicy(s) {}
 
-        t = e;
-        tk->remaining_time -= run;
+    int slice(Handle h) const { return std::min(table.remaining_time[h], sched.time_quantum); }
 
-        while (next < tasks.size() && tasks[next].arrival_time <= t)
-        {
-            rq.push_back(&tasks[next++]);
-        }
-
-        if (tk->remaining_time > 0)
-        {
-            rq.push_back(tk);
-        }
+    void on_tick(Handle h, int s, int e)
+    {
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_RR, table.id[h], s, e);
     }
-
-    log("[RR] Done");
-}
-
-void Scheduler::runPriority()
+};
+
+// Priority with feedback and aging.
+//
+// Aging is a global offset instead of a walk over the queue: every queued
+// task gains AG per dispatch, so a task queued with priority p when the
+// offset was a0 has effective priority p + (age - a0). The heap is keyed on
+// (a0 - p, id), which never changes while queued, and the real priority is
+// written back when the task's slice ends.
+struct PriorityPolicy : SimPolicy
 {
-    // tasks are already sorted by arrival_time
-    log("[PR] Starting with feedback+aging");
-    int t = 0;
+    static const int FF = 50; // feedback factor
+    static const int AG = 1;  // aging increment
 
-    // higher number = higher priority
-    auto pr_cmp = [](Task *a, Task *b)
-    {
-        if (a->priority != b->priority)
-            return a->priority > b->priority;
-        return a->id < b->id;
-    };
+    typedef std::pair<long long, int> PrKey;
+    RunQueue<PrKey> rq;
+    long long age = 0;
+    int prio = 0;             // effective priority of the picked task
 
-    // set to hold tasks in order of priority
-    std::set<Task *, decltype(pr_cmp)> rq(pr_cmp);
+    explicit PriorityPolicy(Scheduler &s) : SimPolicy(s), rq(s.tasks.size()) {}
 
-    size_t next = 0;
+    bool empty() const { return rq.empty(); }
+    void enqueue(Handle h) { rq.push(h, PrKey(age - table.priority[h], table.id[h])); }
 
-    while (next < tasks.size() && tasks[next].arrival_time <= t)
+    // highest-priority task will be at the top of the heap
+    Handle pick()
     {
-        rq.insert(&tasks[next++]);
+        prio = static_cast<int>(age - rq.top_key().first);
+        Handle h = rq.pop();
+        // this is the aging part: every dispatch raises the priority of
+        // the tasks already waiting; those arriving later are not aged
+        age += AG;
+        return h;
     }
 
-    const int FF = 50; // feedback factor
-    const int AG = 1;  // aging increment
+    int slice(Handle h) const { return std::min(table.remaining_time[h], sched.time_quantum); }
 
-    while (!rq.empty() || next < tasks.size())
+    void on_tick(Handle h, int s, int e)
     {
-        if (rq.empty())
-        {
-            t = tasks[next].arrival_time;
-            rq.insert(&tasks[next++]);
-        }
-
-        // highest-priority task will be at the front of the set
-        auto it = rq.begin();
-        Task *tk = *it;
-        rq.erase(it);
-
-        int s = std::max(t, tk->arrival_time);
-        int run = std::min(tk->remaining_time, time_quantum);
-        int e = s + run;
-
-        // record in the timeline
-        _timeline.push_back({tk->id, s, e});
-        log("[PR ] T" + std::to_string(tk->id) +
-            " pr=" + std::to_string(tk->priority) +
-            " " + std::to_string(s) + "->" + std::to_string(e));
-
-        // std::this_thread::sleep_for(std::chrono::milliseconds(run / 10));
-
-        t = e;
-        tk->remaining_time -= run;
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_PR, table.id[h], s, e, prio);
 
         // decrease priority of the current task based on feedback
-        int dec = run / FF;
-        tk->priority = std::max(1, tk->priority - dec);
-        
-        // then increase priority of all tasks in the queue
-        // this is the aging part: tasks that wait longer get higher priority
-        for (auto x : rq)
-        {
-            x->priority += AG;
-        }
-
-        while (next < tasks.size() && tasks[next].arrival_time <= t)
-        {
-            rq.insert(&tasks[next++]);
-        }
-
-        if (tk->remaining_time > 0)
-        {
-            rq.insert(tk);
-        }
+        table.priority[h] = std::max(1, prio - (e - s) / FF);
     }
+};
 
-    log("[PR] Done");
-}
-
-
-void Scheduler::runSJF()
+// Shortest job first, non-preemptive. The ready set is keyed on
+// (remaining_time, id): either a dense array picked by the vectorised
+// argmin, or a heap once there are too many tasks for a scan to pay off.
+struct SJFPolicy : SimPolicy
 {
-    log("[SJF] Starting");
-    int t = 0;
-    size_t next = 0;
-    std::vector<Task *> rq;
-    rq.reserve(tasks.size());
-
-    while (next < tasks.size() && tasks[next].arrival_time <= t)
+    bool scan;
+    ScanQueue<std::int64_t> scan_rq;
+    RunQueue<std::int64_t> heap_rq;
+
+    explicit SJFPolicy(Scheduler &s)
+        : SimPolicy(s),
+          scan(pick_resolve(s.sjf_pick, s.workload ? SIZE_MAX : s.tasks.size()) == PICK_SCAN),
+          scan_rq(scan ? s.tasks.size() : 0),
+          heap_rq(scan ? 0 : s.tasks.size())
     {
-        rq.push_back(&tasks[next++]);
     }
 
-    while (!rq.empty() || next < tasks.size())
-    {
-        if (rq.empty())
-        {
-            t = tasks[next].arrival_time;
-            rq.push_back(&tasks[next++]);
-        }
-
-        // we find the task with the shortest remaining time
-        // and remove it from the ready queue
-        auto it = std::min_element(rq.begin(), rq.end(), [](Task *a, Task *b)
-                                   {
-                                       if (a->remaining_time != b->remaining_time)
-                                           return a->remaining_time < b->remaining_time;
-                                       return a->id < b->id; // tie-break by id
-                                   });
-        Task *tk = *it;
-        rq.erase(it);
-
-        int s = std::max(t, tk->arrival_time);
-        int e = s + tk->remaining_time;
+    bool empty() const { return scan ? scan_rq.empty() : heap_rq.empty(); }
 
-        _timeline.push_back({tk->id, s, e});
-        log("[SJF] T" + std::to_string(tk->id) + " " + std::to_string(s) + "->" + std::to_string(e));
-
-        // std::this_thread::sleep_for(std::chrono::milliseconds(tk->remaining_time / 10));
+    void enqueue(Handle h)
+    {
+        std::int64_t key = pick_pack(table.remaining_time[h], table.id[h]);
+        if (scan)
+            scan_rq.push(h, key);
+        else
+            heap_rq.push(h, key);
+    }
 
-        t = e;
+    Handle pick() { return scan ? scan_rq.pop() : heap_rq.pop(); }
 
-        while (next < tasks.size() && tasks[next].arrival_time <= t)
-        {
-            rq.push_back(&tasks[next++]);
-        }
+    void on_tick(Handle h, int s, int e)
+    {
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_SJF, table.id[h], s, e);
     }
+};
 
-    log("[SJF] Done");
-}
+// three FIFO queues by static priority, non-preemptive:
+// high: pr > 20, medium: 10 < pr <= 20, low: pr <= 10
+struct MLQPolicy : SimPolicy
+{
+    std::deque<Handle> lowQ, medQ, highQ;
 
+    explicit MLQPolicy(Scheduler &s) : SimPolicy(s) {}
 
-void Scheduler::runMLQ()
-{
-    log("[MLQ] Starting (3-level queues)");
-    int t = 0;
-    size_t next = 0;
-    
-    // we have 3 queues: low, medium, high priority
-    // highQ: pr > 20, medQ: 10 < pr <= 20, lowQ: pr <= 10
-    // we use deque for efficient pop_front() and push_back()
-    std::deque<Task *> lowQ, medQ, highQ;
-
-    while (next < tasks.size() && tasks[next].arrival_time <= t)
+    bool empty() const { return highQ.empty() && medQ.empty() && lowQ.empty(); }
+
+    void enqueue(Handle h)
     {
-        Task *tk = &tasks[next++];
-        if (tk->priority > 20)
-            highQ.push_back(tk);
-        else if (tk->priority > 10)
-            medQ.push_back(tk);
+        if (table.priority[h] > 20)
+            highQ.push_back(h);
+        else if (table.priority[h] > 10)
+            medQ.push_back(h);
         else
-            lowQ.push_back(tk);
+            lowQ.push_back(h);
     }
 
-    while (!highQ.empty() || !medQ.empty() || !lowQ.empty() || next < tasks.size())
+    Handle pick()
     {
-        if (highQ.empty() && medQ.empty() && lowQ.empty())
-        {
-            t = tasks[next].arrival_time;
-            Task *tk = &tasks[next++];
-            if (tk->priority > 20)
-                highQ.push_back(tk);
-            else if (tk->priority > 10)
-                medQ.push_back(tk);
-            else
-                lowQ.push_back(tk);
-        }
+        std::deque<Handle> &q = !highQ.empty() ? highQ : !medQ.empty() ? medQ : lowQ;
+        Handle h = q.front();
+        q.pop_front();
+        return h;
+    }
 
-        Task *tk;
-        if (!highQ.empty())
-        {
-            tk = highQ.front();
-            highQ.pop_front();
-        }
-        else if (!medQ.empty())
-        {
-            tk = medQ.front();
-            medQ.pop_front();
-        }
-        else
-        {
-            tk = lowQ.front();
-            lowQ.pop_front();
-        }
+    void on_tick(Handle h, int s, int e)
+    {
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_MLQ, table.id[h], s, e, table.priority[h]);
+    }
+};
 
-        int s = std::max(t, tk->arrival_time);
-        int e = s + tk->remaining_time;
+// Three feedback levels with quanta q, 2q and 4q. Arrivals enter level 0
+// and a task that uses up its quantum moves one level down; table.level
+// holds the task's current level.
+struct MLFQPolicy : SimPolicy
+{
+    static const int LEVELS = 3;
+    std::deque<Handle> queues[LEVELS];
 
-        _timeline.push_back({tk->id, s, e});
-        log("[MLQ] T" + std::to_string(tk->id) +
-            " pr=" + std::to_string(tk->priority) +
-            " " + std::to_string(s) + "->" + std::to_string(e));
+    explicit MLFQPolicy(Scheduler &s) : SimPolicy(s) {}
 
-        // std::this_thread::sleep_for(std::chrono::milliseconds(tk->remaining_time / 10));
+    bool empty() const { return queues[0].empty() && queues[1].empty() && queues[2].empty(); }
 
-        t = e;
+    void on_arrival(Handle h) { table.level[h] = 0; }
+    void enqueue(Handle h) { queues[table.level[h]].push_back(h); }
 
-        while (next < tasks.size() && tasks[next].arrival_time <= t)
-        {
-            Task *nt = &tasks[next++];
-            if (nt->priority > 20)
-                highQ.push_back(nt);
-            else if (nt->priority > 10)
-                medQ.push_back(nt);
-            else
-                lowQ.push_back(nt);
-        }
+    // we select the highest-priority non-empty queue
+    Handle pick()
+    {
+        int lvl = 0;
+        while (queues[lvl].empty())
+            ++lvl;
+        Handle h = queues[lvl].front();
+        queues[lvl].pop_front();
+        return h;
     }
 
-    log("[MLQ] Done");
-}
-
-void Scheduler::runMLFQ()
-{
-    log("[MLFQ] Starting (3-level MLFQ)");
-    int t = 0;
-    size_t next = 0;
-    // we have 3 queues: q0, q1, q2
-    // q0: time_quantum, q1: 2*quantum, q2: 4*quantum
-
-    const int levels = 3;
-    std::vector<std::deque<Task *>> queues(levels);
-
-    while (next < tasks.size() && tasks[next].arrival_time <= t)
+    int slice(Handle h) const
     {
-        queues[0].push_back(&tasks[next++]);
+        return std::min(table.remaining_time[h], sched.time_quantum * (1 << table.level[h]));
     }
 
-    while (next < tasks.size() || !queues[0].empty() || !queues[1].empty() || !queues[2].empty())
+    void on_tick(Handle h, int s, int e)
     {
-        // we select the highest-priority non-empty queue
-        int lvl = -1;
-        for (int i = 0; i < levels; ++i)
-        {
-            if (!queues[i].empty())
-            {
-                lvl = i;
-                break;
-            }
-        }
-
-        if (lvl < 0)
-        {
-            t = tasks[next].arrival_time;
-            queues[0].push_back(&tasks[next++]);
-            lvl = 0;
-        }
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_MLFQ, table.id[h], s, e, table.level[h]);
+        table.level[h] = std::min(table.level[h] + 1, LEVELS - 1);
+    }
+};
 
-        Task *tk = queues[lvl].front();
-        queues[lvl].pop_front();
+// earliest deadline first, one quantum at a time; heap keyed on (deadline, id)
+struct EDFPolicy : SimPolicy
+{
+    typedef std::pair<int, int> DlKey;
+    RunQueue<DlKey> rq;
 
-        int quantum = time_quantum * (1 << lvl);
-        int s = std::max(t, tk->arrival_time);
-        int run = std::min(tk->remaining_time, quantum);
-        int e = s + run;
+    explicit EDFPolicy(Scheduler &s) : SimPolicy(s), rq(s.tasks.size()) {}
 
-        _timeline.push_back({tk->id, s, e});
-        log("[MLFQ] T" + std::to_string(tk->id) +
-            " L" + std::to_string(lvl) +
-            " " + std::to_string(s) + "->" + std::to_string(e));
+    bool empty() const { return rq.empty(); }
+    void enqueue(Handle h) { rq.push(h, DlKey(table.deadline[h], table.id[h])); }
+    Handle pick() { return rq.pop(); }
 
-        // std::this_thread::sleep_for(std::chrono::milliseconds(run / 10));
+    int slice(Handle h) const { return std::min(table.remaining_time[h], sched.time_quantum); }
 
-        t = e;
-        tk->remaining_time -= run;
+    void on_tick(Handle h, int s, int e)
+    {
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_EDF, table.id[h], s, e, table.deadline[h]);
+    }
+};
 
-        // we them have to enqueue tasks that arrived up to time t into level 0
-        while (next < tasks.size() && tasks[next].arrival_time <= t)
+// Completely fair: the task with the least virtual runtime runs next, and
+// vruntime grows by slice / priority. The timeline is ordered by
+// (vruntime, id); vruntime and the tree links are columns of the task
+// table, so (re)queueing never allocates.
+struct CFSPolicy : SimPolicy
+{
+    struct TimelineOps
+    {
+        TaskTable *table;
+        RBLinks &links(Handle h) { return table->cfs_node[h]; }
+        bool less(Handle a, Handle b) const
         {
-            queues[0].push_back(&tasks[next++]);
+            double va = table->vruntime[a], vb = table->vruntime[b];
+            return va < vb || (va == vb && table->id[a] < table->id[b]);
         }
+    };
+    IntrusiveRBTree<TimelineOps> rq;
 
-        // if the task is not finished, we requeue it to the next level
-        // if it is finished, we do not enqueue it again
-        if (tk->remaining_time > 0)
-        {
-            int newLvl = std::min(lvl + 1, levels - 1);
-            queues[newLvl].push_back(tk);
-        }
-    }
+    explicit CFSPolicy(Scheduler &s) : SimPolicy(s), rq(TimelineOps{&s.table}) {}
 
-    log("[MLFQ] Done");
-}
+    bool empty() const { return rq.empty(); }
 
+    // new arrivals start with no virtual runtime
+    void on_arrival(Handle h) { table.vruntime[h] = 0.0; }
+    void enqueue(Handle h) { rq.insert(h); }
 
-void Scheduler::runEDF()
-{
-    log("[EDF] Starting");
-    int t = 0;
-    size_t next = 0;
+    // the task with minimum vruntime (cached leftmost)
+    Handle pick() { return rq.pop_leftmost(); }
 
-    // we use a multiset to keep track of the tasks in order of deadline
-    auto edf_cmp = [](Task *a, Task *b)
-    {
-        if (a->deadline != b->deadline)
-            return a->deadline < b->deadline;
-        return a->id < b->id;
-    };
-    std::multiset<Task *, decltype(edf_cmp)> rq(edf_cmp);
+    int slice(Handle h) const { return std::min(table.remaining_time[h], sched.time_quantum); }
 
-    while (next < tasks.size() && tasks[next].arrival_time <= t)
+    void on_tick(Handle h, int s, int e)
     {
-        rq.insert(&tasks[next++]);
+        if (SCHED_LOG_ON(LOG_DEBUG, sched.log_level))
+            sched.trace(EV_CFS, table.id[h], s, e, 0, table.vruntime[h]);
+        table.vruntime[h] += double(e - s) / table.priority[h];
     }
+};
 
-    while (!rq.empty() || next < tasks.size())
-    {
-        if (rq.empty())
-        {
-            t = tasks[next].arrival_time;
-            rq.insert(&tasks[next++]);
-        }
-
-        // we dequeue the task with the earliest deadline
-        Task *tk = *rq.begin();
-        rq.erase(rq.begin());
+} // namespace
 
-        int s = std::max(t, tk->arrival_time);
-        int run = std::min(tk->remaining_time, time_quantum);
-        int e = s + run;
+void Scheduler::runFCFS()
+{
+    log("[FCFS] Starting");
+    FCFSPolicy policy(*this);
+    simulate(*this, policy);
+    log("[FCFS] Done");
+}
 
-        _timeline.push_back({tk->id, s, e});
-        log("[EDF] T" + std::to_string(tk->id) + " dl=" + std::to_string(tk->deadline) +
-            " " + std::to_string(s) + "->" + std::to_string(e));
+void Scheduler::runRR()
+{
+    log("[RR] Starting");
+    RRPolicy policy(*this);
+    simulate(*this, policy);
+    log("[RR] Done");
+}
 
-        // std::this_thread::sleep_for(std::chrono::milliseconds(run / 10));
+void Scheduler::runPriority()
+{
+    log("[PR] Starting with feedback+aging");
+    PriorityPolicy policy(*this);
+    simulate(*this, policy);
+    log("[PR] Done");
+}
 
-        t = e;
-        tk->remaining_time -= run;
+void Scheduler::runSJF()
+{
+    log("[SJF] Starting");
+    SJFPolicy policy(*this);
+    simulate(*this, policy);
+    log("[SJF] Done");
+}
 
-        while (next < tasks.size() && tasks[next].arrival_time <= t)
-        {
-            rq.insert(&tasks[next++]);
-        }
+void Scheduler::runMLQ()
+{
+    log("[MLQ] Starting (3-level queues)");
+    MLQPolicy policy(*this);
+    simulate(*this, policy);
+    log("[MLQ] Done");
+}
 
-        if (tk->remaining_time > 0)
-        {
-            rq.insert(tk);
-        }
-    }
+void Scheduler::runMLFQ()
+{
+    log("[MLFQ] Starting (3-level MLFQ)");
+    MLFQPolicy policy(*this);
+    simulate(*this, policy);
+    log("[MLFQ] Done");
+}
 
+void Scheduler::runEDF()
+{
+    log("[EDF] Starting");
+    EDFPolicy policy(*this);
+    simulate(*this, policy);
     log("[EDF] Done");
 }
 
 void Scheduler::runCFS()
 {
     log("[CFS] Starting (with arrival times)");
-    int t = 0;
-    size_t next = 0;
-    size_t n = tasks.size();
-
-    // we use vector to hold the tasks in order of arrival time
-    std::vector<Task *> upcoming;
-    upcoming.reserve(n);
-    for (auto &tk : tasks)
-        upcoming.push_back(&tk);
-
-
-    // this is a mapping of task pointer to virtual runtime
-    std::unordered_map<Task *, double> vruntime;
-
-    // pick smallest vruntime, tie-break on id
-    auto cmp = [&](Task *a, Task *b)
-    {
-        double va = vruntime[a], vb = vruntime[b];
-        if (va != vb)
-            return va < vb;
-        return a->id < b->id;
-    };
-
-    // we use  multiset (rbt)
-    std::multiset<Task *, decltype(cmp)> rq(cmp);
-
-    while (next < n && upcoming[next]->arrival_time <= t)
-    {
-        Task *p = upcoming[next++];
-        vruntime[p] = 0.0;
-        rq.insert(p);
-    }
-
-    while (next < n || !rq.empty())
-    {
-        if (rq.empty())
-        {
-            t = upcoming[next]->arrival_time;
-            while (next < n && upcoming[next]->arrival_time <= t)
-            {
-                Task *p = upcoming[next++];
-                vruntime[p] = 0.0;
-                rq.insert(p);
-            }
-        }
-
-        // dequeue the task with minimum vruntime
-        auto it = rq.begin();
-        Task *tk = *it;
-        rq.erase(it);
-
-        // Calculate slice and times
-        int slice = std::min(tk->remaining_time, time_quantum);
-        int s = std::max(t, tk->arrival_time);
-        int e = s + slice;
-
-        _timeline.push_back({tk->id, s, e});
-        log("[CFS] T" + std::to_string(tk->id) + " vruntime=" + std::to_string(vruntime[tk]) +
-            " " + std::to_string(s) + "->" + std::to_string(e));
-
-        // std::this_thread::sleep_for(std::chrono::milliseconds(slice / 10));
-
-        t = e;
-        tk->remaining_time -= slice;
-        vruntime[tk] += double(slice) / tk->priority;
-
-        while (next < n && upcoming[next]->arrival_time <= t)
-        {
-            Task *p = upcoming[next++];
-            vruntime[p] = 0.0;
-            rq.insert(p);
-        }
-
-        if (tk->remaining_time > 0)
-        {
-            rq.insert(tk);
-        }
-    }
-
+    CFSPolicy policy(*this);
+    simulate(*this, policy);
     log("[CFS] Done");
 }
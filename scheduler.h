@@ -1,9 +1,15 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <functional>
+#include <memory>
+#include "pick_kernels.h"
+#include "rb_tree.h"
+#include "sched_log.h"
 
 enum Algorithm {
     FCFS, RR, PRIORITY,
@@ -20,6 +26,56 @@ struct Task {
     int level;              
 };
 
+// The tasks of a run, one column per field (struct of arrays). Policies
+// address a task by its 32-bit row, so a scan over the ready set streams
+// through the one column it compares instead of whole Task records.
+struct TaskTable {
+    typedef std::uint32_t Handle;
+
+    std::vector<int> id, priority, remaining_time, arrival_time, deadline, level;
+    std::vector<double> vruntime;     // CFS virtual runtime
+    std::vector<RBLinks> cfs_node;    // CFS timeline links
+
+    std::size_t size() const { return id.size(); }
+
+    void clear() {
+        id.clear(); priority.clear(); remaining_time.clear(); arrival_time.clear();
+        deadline.clear(); level.clear(); vruntime.clear(); cfs_node.clear();
+    }
+
+    void reserve(std::size_t n) {
+        id.reserve(n); priority.reserve(n); remaining_time.reserve(n); arrival_time.reserve(n);
+        deadline.reserve(n); level.reserve(n); vruntime.reserve(n); cfs_node.reserve(n);
+    }
+
+    Handle add(const Task &t) {
+        id.push_back(t.id);
+        priority.push_back(t.priority);
+        remaining_time.push_back(t.remaining_time);
+        arrival_time.push_back(t.arrival_time);
+        deadline.push_back(t.deadline);
+        level.push_back(t.level);
+        vruntime.push_back(0.0);
+        cfs_node.push_back(RBLinks());
+        return static_cast<Handle>(id.size() - 1);
+    }
+
+    // overwrite row h, e.g. to reuse the slot of a finished task
+    void set(Handle h, const Task &t) {
+        id[h] = t.id;
+        priority[h] = t.priority;
+        remaining_time[h] = t.remaining_time;
+        arrival_time[h] = t.arrival_time;
+        deadline[h] = t.deadline;
+        level[h] = t.level;
+        vruntime[h] = 0.0;
+        cfs_node[h] = RBLinks();
+    }
+};
+
+class WorkloadSource;
+class TimelineWriter;
+
 struct TimelineEntry {
     int id;
     int start_time;
@@ -31,6 +87,16 @@ public:
     Scheduler(Algorithm algo,
               int timeQuantum = 100,
               std::function<void(const std::string&)> logger = nullptr);
+    ~Scheduler();
+
+    // Replay tasks from a stream instead of `tasks`. The next run() pulls
+    // them as they arrive and reuses the slot of every finished task, so
+    // `table` only ever holds the live ones. The source is consumed.
+    void setWorkload(std::unique_ptr<WorkloadSource> source);
+
+    // Append the timeline to `out` (not owned) instead of keeping it in
+    // _timeline, which then stays empty; pass nullptr to switch back.
+    void setTimelineOutput(TimelineWriter *out);
 
     void run();
     const std::vector<TimelineEntry>& timeline() const;
@@ -44,13 +110,25 @@ public:
     void runEDF();
     void runCFS();
 
-    void log(const std::string& msg);
+    // plain-text message; queued events are written out first
+    void log(const std::string& msg, LogLevel level = LOG_INFO);
+    // binary per-slice event, formatted later by flushLog()
+    void trace(std::uint16_t kind, int id, int start, int end, int arg = 0, double value = 0.0);
+    void flushLog();
+    void record(int id, int start, int end);
 
     Algorithm algorithm;
     int time_quantum;
-    std::vector<Task> tasks;
+    std::vector<Task> tasks;          // input; run() leaves it untouched
+    TaskTable table;                  // working copy the policies mutate
     std::vector<TimelineEntry> _timeline;
     std::function<void(const std::string&)> logger;
+    int log_level = LOG_DEBUG;
+    PickMode sjf_pick = PICK_AUTO;    // SJF ready set: scan or heap
+    EventLog events;
+    std::unique_ptr<WorkloadSource> workload;
+    std::string workload_error;       // why run() stopped reading it early
+    TimelineWriter *timeline_out = nullptr;
 };
 
 #endif
@@ -0,0 +1,369 @@
+// scheduler_bench.cpp
+// Microbenchmarks for every Scheduler and ThreadedScheduler policy.
+//
+//   scheduler_bench [--min-size N] [--max-size N] [--threaded-max-size N]
+//                   [--budget SEC] [--min-time SEC] [--workers N]
+//                   [--filter TEXT] [--out FILE.json]
+//                   [--pick auto|queue|scan] [--isa scalar|avx2|avx512]
+//
+// Each policy runs on seeded random workloads of 10^k tasks, from --min-size
+// up to --max-size, and stops growing once one run exceeds --budget seconds
+// (the quadratic policies never reach 10^7). Threaded policies stop at
+// --threaded-max-size: every live ULT owns a guarded stack mapping, and the
+// per-process mapping limit caps how many can be queued at once. Small sizes
+// repeat until --min-time has elapsed. A dispatch decision is one timeline
+// slice. Memory per task is the peak heap growth during setup and run,
+// counted by the operator new below, divided by the task count. Threaded
+// policies add ULT stack address space separately. With --out the results
+// are also written as JSON, in the layout Google Benchmark uses, so runs can
+// be diffed across releases. --pick and --isa force the ready-set layout
+// and argmin kernel of the scan-capable policies (pick_kernels.h).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pick_kernels.h"
+#include "scheduler.h"
+#include "threadedscheduler.h"
+#include "ult_context.h"
+#include "ult_stack.h"
+
+// ---- heap accounting -------------------------------------------------------
+
+static std::atomic<long long> g_heap_now{0};
+static std::atomic<long long> g_heap_peak{0};
+
+static void heap_add(long long n) {
+    long long now = g_heap_now.fetch_add(n, std::memory_order_relaxed) + n;
+    long long peak = g_heap_peak.load(std::memory_order_relaxed);
+    while (now > peak && !g_heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+}
+
+// every block carries its size in a header of `align` bytes
+static void* counted_alloc(std::size_t size, std::size_t align) {
+    if (align < alignof(std::max_align_t)) align = alignof(std::max_align_t);
+#if defined(_WIN32)
+    char* p = static_cast<char*>(_aligned_malloc(size + align, align));
+#else
+    char* p = nullptr;
+    if (posix_memalign(reinterpret_cast<void**>(&p), align, size + align) != 0) p = nullptr;
+#endif
+    if (!p) throw std::bad_alloc();
+    *reinterpret_cast<std::size_t*>(p + align - sizeof(std::size_t)) = size;
+    heap_add(static_cast<long long>(size));
+    return p + align;
+}
+
+static void counted_free(void* ptr, std::size_t align) {
+    if (!ptr) return;
+    if (align < alignof(std::max_align_t)) align = alignof(std::max_align_t);
+    char* p = static_cast<char*>(ptr) - align;
+    heap_add(-static_cast<long long>(*reinterpret_cast<std::size_t*>(p + align - sizeof(std::size_t))));
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(std::size_t n) { return counted_alloc(n, 0); }
+void* operator new[](std::size_t n) { return counted_alloc(n, 0); }
+void* operator new(std::size_t n, std::align_val_t a) { return counted_alloc(n, static_cast<std::size_t>(a)); }
+void* operator new[](std::size_t n, std::align_val_t a) { return counted_alloc(n, static_cast<std::size_t>(a)); }
+void operator delete(void* p) noexcept { counted_free(p, 0); }
+void operator delete[](void* p) noexcept { counted_free(p, 0); }
+void operator delete(void* p, std::size_t) noexcept { counted_free(p, 0); }
+void operator delete[](void* p, std::size_t) noexcept { counted_free(p, 0); }
+void operator delete(void* p, std::align_val_t a) noexcept { counted_free(p, static_cast<std::size_t>(a)); }
+void operator delete[](void* p, std::align_val_t a) noexcept { counted_free(p, static_cast<std::size_t>(a)); }
+void operator delete(void* p, std::size_t, std::align_val_t a) noexcept { counted_free(p, static_cast<std::size_t>(a)); }
+void operator delete[](void* p, std::size_t, std::align_val_t a) noexcept { counted_free(p, static_cast<std::size_t>(a)); }
+
+// ---- benchmarks ------------------------------------------------------------
+
+struct Options {
+    long min_size = 100;
+    long max_size = 10000000;
+    long threaded_max_size = 10000;
+    double budget = 2.0;        // seconds; stop growing a policy past this
+    double min_time = 0.2;      // seconds of repetitions per measurement
+    int workers = 1;
+    std::string filter;
+    std::string out;
+    PickMode pick = PICK_AUTO;
+};
+
+static const char* pick_names[] = { "auto", "queue", "scan" };
+
+struct Result {
+    std::string name;
+    std::string family;         // "Scheduler" or "ThreadedScheduler"
+    std::string policy;
+    long tasks;
+    long iterations;
+    double seconds;             // mean wall time of one run
+    double decisions;           // timeline slices of one run
+    double bytes_per_task;
+    double stack_bytes_per_task;
+};
+
+struct Spec {
+    int id, priority, burst, arrival, deadline;
+};
+
+// arrivals are spread so the ready queue holds a realistic backlog
+static std::vector<Spec> make_workload(long n, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> pri(1, 30), burst(1, 500), dl(1, 500000);
+    std::uniform_int_distribution<long> arr(0, n * 40);
+    std::vector<Spec> w(n);
+    for (long i = 0; i < n; ++i)
+        w[i] = { static_cast<int>(i + 1), pri(gen), burst(gen), static_cast<int>(arr(gen)), dl(gen) };
+    std::sort(w.begin(), w.end(), [](const Spec& a, const Spec& b) { return a.arrival < b.arrival; });
+    return w;
+}
+
+struct Sample {
+    double seconds;
+    std::size_t decisions;
+    long long heap_peak;
+    std::size_t stack_bytes;
+};
+
+static Sample run_basic(Algorithm algo, const std::vector<Spec>& w, PickMode pick) {
+    long long base = g_heap_now.load();
+    g_heap_peak.store(base);
+    Sample s = {};
+    {
+        Scheduler sched(algo, 50, [](const std::string&) {});
+        sched.log_level = LOG_OFF;
+        sched.sjf_pick = pick;
+        sched.tasks.clear();
+        sched.tasks.reserve(w.size());
+        for (const Spec& t : w) {
+            Task tk = {};
+            tk.id = t.id;
+            tk.priority = t.priority;
+            tk.remaining_time = t.burst;
+            tk.arrival_time = t.arrival;
+            tk.deadline = t.deadline;
+            sched.tasks.push_back(tk);
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        sched.run();
+        auto t1 = std::chrono::steady_clock::now();
+        s.seconds = std::chrono::duration<double>(t1 - t0).count();
+        s.decisions = sched.timeline().size();
+        s.heap_peak = g_heap_peak.load() - base;
+    }
+    return s;
+}
+
+static Sample run_threaded(ThreadedAlgorithm algo, const std::vector<Spec>& w, int workers, PickMode pick) {
+    ult_stack_trim();
+    long long base = g_heap_now.load();
+    g_heap_peak.store(base);
+    Sample s = {};
+    {
+        ThreadedScheduler ts(algo, 50, [](const std::string&) {});
+        ts.log_level = LOG_OFF;
+        ts.work_ms = 0;
+        ts.workers = workers;
+        ts.priority_pick = pick;
+        if (pick != PICK_AUTO) ts.cfs_pick = pick;
+        ts.tasks.clear();
+        ts.tasks.reserve(w.size());
+        for (const Spec& t : w)
+            ts.tasks.add(t.id, t.priority % 10 + 1, t.burst, t.arrival);
+        auto t0 = std::chrono::steady_clock::now();
+        ts.run();
+        auto t1 = std::chrono::steady_clock::now();
+        s.seconds = std::chrono::duration<double>(t1 - t0).count();
+        s.decisions = ts.timeline().size();
+        s.heap_peak = g_heap_peak.load() - base;
+        s.stack_bytes = ult_stack_stats().mapped_bytes;
+    }
+    return s;
+}
+
+template <typename RunOnce>
+static void bench_policy(const Options& opt, long max_size, const std::string& family,
+                         const std::string& policy, RunOnce run_once, std::vector<Result>& results) {
+    for (long n = opt.min_size; n <= max_size; n *= 10) {
+        std::string name = family + "/" + policy + "/" + std::to_string(n);
+        if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos) continue;
+
+        std::vector<Spec> w = make_workload(n, static_cast<unsigned>(n));
+        Result r = { name, family, policy, n, 0, 0.0, 0.0, 0.0, 0.0 };
+        double total = 0, decisions = 0;
+        long long peak = 0;
+        std::size_t stack = 0;
+        do {
+            Sample s = run_once(w);
+            total += s.seconds;
+            decisions += static_cast<double>(s.decisions);
+            peak = std::max(peak, s.heap_peak);
+            stack = std::max(stack, s.stack_bytes);
+            ++r.iterations;
+        } while (total < opt.min_time);
+
+        r.seconds = total / r.iterations;
+        r.decisions = decisions / r.iterations;
+        r.bytes_per_task = static_cast<double>(peak) / n;
+        r.stack_bytes_per_task = static_cast<double>(stack) / n;
+        results.push_back(r);
+
+        std::printf("%-40s %10ld it %12.1f ns/decision %14.0f decisions/s %10.1f B/task",
+                    name.c_str(), r.iterations, r.seconds * 1e9 / std::max(1.0, r.decisions),
+                    r.decisions / r.seconds, r.bytes_per_task);
+        if (r.stack_bytes_per_task > 0) std::printf(" +%.0f B/task stacks", r.stack_bytes_per_task);
+        std::printf("\n");
+        std::fflush(stdout);
+
+        if (r.seconds > opt.budget) break;
+    }
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string o;
+    for (char c : s) {
+        if (c == '"' || c == '\\') o += '\\';
+        o += c;
+    }
+    return o;
+}
+
+static bool write_json(const std::string& path, const Options& opt, const std::vector<Result>& results) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    std::fprintf(f, "{\n  \"context\": {\n");
+    std::fprintf(f, "    \"date\": \"%s\",\n", date);
+    std::fprintf(f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    std::fprintf(f, "    \"workers\": %d,\n", opt.workers);
+    std::fprintf(f, "    \"pick\": \"%s\",\n", pick_names[opt.pick]);
+    std::fprintf(f, "    \"isa\": \"%s\",\n", pick_isa_name(pick_isa()));
+#ifdef NDEBUG
+    std::fprintf(f, "    \"library_build_type\": \"release\"\n");
+#else
+    std::fprintf(f, "    \"library_build_type\": \"debug\"\n");
+#endif
+    std::fprintf(f, "  },\n  \"benchmarks\": [\n");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        double ns_per = r.seconds * 1e9 / std::max(1.0, r.decisions);
+        std::fprintf(f, "    {\n");
+        std::fprintf(f, "      \"name\": \"%s\",\n", json_escape(r.name).c_str());
+        std::fprintf(f, "      \"family\": \"%s\",\n", r.family.c_str());
+        std::fprintf(f, "      \"policy\": \"%s\",\n", r.policy.c_str());
+        std::fprintf(f, "      \"tasks\": %ld,\n", r.tasks);
+        std::fprintf(f, "      \"iterations\": %ld,\n", r.iterations);
+        std::fprintf(f, "      \"real_time\": %.1f,\n", r.seconds * 1e9);
+        std::fprintf(f, "      \"time_unit\": \"ns\",\n");
+        std::fprintf(f, "      \"decisions\": %.0f,\n", r.decisions);
+        std::fprintf(f, "      \"ns_per_decision\": %.3f,\n", ns_per);
+        std::fprintf(f, "      \"decisions_per_second\": %.1f,\n", r.decisions / r.seconds);
+        std::fprintf(f, "      \"bytes_per_task\": %.2f,\n", r.bytes_per_task);
+        std::fprintf(f, "      \"stack_bytes_per_task\": %.2f\n", r.stack_bytes_per_task);
+        std::fprintf(f, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    return std::fclose(f) == 0;
+}
+
+static bool parse_pick(const char* v, PickMode& pick) {
+    for (int m = PICK_AUTO; m <= PICK_SCAN; ++m) {
+        if (std::strcmp(v, pick_names[m]) == 0) {
+            pick = static_cast<PickMode>(m);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_isa(const char* v) {
+    for (int i = PICK_ISA_SCALAR; i <= PICK_ISA_AVX512; ++i) {
+        if (std::strcmp(v, pick_isa_name(static_cast<PickIsa>(i))) == 0) {
+            if (pick_set_isa(static_cast<PickIsa>(i))) return true;
+            std::fprintf(stderr, "this CPU does not support %s\n", v);
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&](const char* flag) -> const char* {
+            if (a != flag || i + 1 >= argc) return nullptr;
+            return argv[++i];
+        };
+        const char* v;
+        if ((v = value("--min-size"))) opt.min_size = std::max(1L, std::atol(v));
+        else if ((v = value("--max-size"))) opt.max_size = std::atol(v);
+        else if ((v = value("--threaded-max-size"))) opt.threaded_max_size = std::atol(v);
+        else if ((v = value("--budget"))) opt.budget = std::atof(v);
+        else if ((v = value("--min-time"))) opt.min_time = std::atof(v);
+        else if ((v = value("--workers"))) opt.workers = std::max(1, std::atoi(v));
+        else if ((v = value("--filter"))) opt.filter = v;
+        else if ((v = value("--out"))) opt.out = v;
+        else if ((v = value("--pick")) && parse_pick(v, opt.pick)) continue;
+        else if ((v = value("--isa")) && parse_isa(v)) continue;
+        else {
+            std::fprintf(stderr,
+                         "usage: %s [--min-size N] [--max-size N] [--threaded-max-size N]\n"
+                         "          [--budget SEC] [--min-time SEC] [--workers N]\n"
+                         "          [--filter TEXT] [--out FILE.json]\n"
+                         "          [--pick auto|queue|scan] [--isa scalar|avx2|avx512]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) return 2;
+
+    std::vector<Result> results;
+    static const char* basic[] = { "FCFS", "RR", "PRIORITY", "SJF", "MLQ", "MLFQ", "EDF", "CFS" };
+    for (int a = FCFS; a <= CFS; ++a) {
+        bench_policy(opt, opt.max_size, "Scheduler", basic[a], [&](const std::vector<Spec>& w) {
+            return run_basic(static_cast<Algorithm>(a), w, opt.pick);
+        }, results);
+    }
+
+    scheduler_fiber = ult_convert_thread();
+    if (!scheduler_fiber) {
+        std::fprintf(stderr, "ult_convert_thread failed\n");
+        return 1;
+    }
+    static const char* threaded[] = { "T_FCFS", "T_RR", "T_PRIORITY", "T_MLFQ", "T_CFS" };
+    for (int a = T_FCFS; a <= T_CFS; ++a) {
+        long max_size = std::min(opt.max_size, opt.threaded_max_size);
+        bench_policy(opt, max_size, "ThreadedScheduler", threaded[a], [&](const std::vector<Spec>& w) {
+            return run_threaded(static_cast<ThreadedAlgorithm>(a), w, opt.workers, opt.pick);
+        }, results);
+    }
+    ult_convert_back();
+
+    if (!opt.out.empty() && !write_json(opt.out, opt, results)) {
+        std::fprintf(stderr, "cannot write %s\n", opt.out.c_str());
+        return 1;
+    }
+    return 0;
+}
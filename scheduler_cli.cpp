@@ -0,0 +1,260 @@
+// scheduler_cli.cpp
+// Headless driver for the scheduling core.
+//
+//   scheduler_cli [--algo NAME] [--quantum N]
+//                 [--threaded [--workers N] [--work-ms N] [--preempt-us N]]
+//                 [--workload FILE | --tasks N [--seed S]]
+//                 [--timeline FILE] [--log LEVEL] [--print]
+//   scheduler_cli --sweep [--sizes N,N..] [--quanta N,N..] [--seeds N]
+//                 [--threads N] [--out FILE.csv]
+//
+// The first form runs one policy and prints its slice count, wall time and
+// average response/turnaround/waiting times. Without --workload or --tasks
+// it uses the scheduler's built-in demo tasks. --workload streams a CSV or
+// binary workload file; since those tasks are never all in memory, no
+// metrics are printed for it, and a file that cannot be read to the end
+// is reported on stderr with exit status 1. --timeline writes the timeline to a file
+// (see timeline_store.h) instead of keeping it in memory. --preempt-us
+// makes threaded ULTs CPU-bound and preempts them by timer (Linux; see
+// ult_preempt.h), spending N us of wall time per quantum. The second form
+// runs analysis.h's parameter sweep and writes it as CSV.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "analysis.h"
+#include "scheduler.h"
+#include "threadedscheduler.h"
+#include "timeline_store.h"
+#include "ult_context.h"
+#include "workload.h"
+
+struct Options {
+    std::string algo = "RR";
+    int quantum = 100;
+    bool threaded = false;
+    int workers = 1;
+    int work_ms = 30;
+    int preempt_us = 0;
+    std::string workload;
+    int tasks = 0;
+    unsigned seed = 1;
+    std::string timeline;
+    int log_level = LOG_OFF;
+    bool print = false;
+
+    bool sweep = false;
+    SweepConfig sweep_cfg;
+    std::string out = "metrics.csv";
+};
+
+static const char* const basic_names[] = { "FCFS", "RR", "PRIORITY", "SJF", "MLQ", "MLFQ", "EDF", "CFS" };
+static const char* const threaded_names[] = { "FCFS", "RR", "PRIORITY", "MLFQ", "CFS" };
+static const char* const level_names[] = { "off", "error", "info", "debug", "trace" };
+
+static int find_name(const std::string& s, const char* const* names, int count) {
+    for (int i = 0; i < count; ++i)
+        if (s == names[i]) return i;
+    return -1;
+}
+
+static bool parse_list(const char* s, std::vector<int>& out) {
+    out.clear();
+    for (char* end; *s; s = end) {
+        long v = std::strtol(s, &end, 10);
+        if (end == s || v <= 0) return false;
+        out.push_back(static_cast<int>(v));
+        if (*end == ',') ++end;
+    }
+    return !out.empty();
+}
+
+static void usage(const char* prog) {
+    std::fprintf(stderr,
+                 "usage: %s [--algo NAME] [--quantum N]\n"
+                 "          [--threaded [--workers N] [--work-ms N] [--preempt-us N]]\n"
+                 "          [--workload FILE | --tasks N [--seed S]]\n"
+                 "          [--timeline FILE] [--log off|error|info|debug|trace] [--print]\n"
+                 "       %s --sweep [--sizes N,N..] [--quanta N,N..] [--seeds N]\n"
+                 "          [--threads N] [--out FILE.csv]\n"
+                 "policies: FCFS RR PRIORITY SJF MLQ MLFQ EDF CFS\n"
+                 "          (--threaded: FCFS RR PRIORITY MLFQ CFS)\n", prog, prog);
+}
+
+static bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        auto value = [&](const char* name) -> const char* {
+            if (std::strcmp(argv[i], name) != 0) return nullptr;
+            if (i + 1 >= argc) return nullptr;
+            return argv[++i];
+        };
+        const char* v;
+        if (!std::strcmp(argv[i], "--threaded")) opt.threaded = true;
+        else if (!std::strcmp(argv[i], "--print")) opt.print = true;
+        else if (!std::strcmp(argv[i], "--sweep")) opt.sweep = true;
+        else if ((v = value("--algo"))) opt.algo = v;
+        else if ((v = value("--quantum"))) opt.quantum = std::atoi(v);
+        else if ((v = value("--workers"))) opt.workers = std::atoi(v);
+        else if ((v = value("--work-ms"))) opt.work_ms = std::atoi(v);
+        else if ((v = value("--preempt-us"))) opt.preempt_us = std::atoi(v);
+        else if ((v = value("--workload"))) opt.workload = v;
+        else if ((v = value("--tasks"))) opt.tasks = std::atoi(v);
+        else if ((v = value("--seed"))) opt.seed = static_cast<unsigned>(std::strtoul(v, nullptr, 10));
+        else if ((v = value("--timeline"))) opt.timeline = v;
+        else if ((v = value("--log"))) {
+            opt.log_level = find_name(v, level_names, 5);
+            if (opt.log_level < 0) return false;
+        }
+        else if ((v = value("--sizes"))) { if (!parse_list(v, opt.sweep_cfg.sizes)) return false; }
+        else if ((v = value("--quanta"))) { if (!parse_list(v, opt.sweep_cfg.quanta)) return false; }
+        else if ((v = value("--seeds"))) opt.sweep_cfg.seeds = std::atoi(v);
+        else if ((v = value("--threads"))) opt.sweep_cfg.threads = std::atoi(v);
+        else if ((v = value("--out"))) opt.out = v;
+        else return false;
+    }
+    return opt.quantum > 0 && opt.workers > 0 && opt.work_ms >= 0 && opt.preempt_us >= 0 && opt.tasks >= 0;
+}
+
+static void print_metrics(const RunMetrics& m) {
+    std::printf("avg response   %.2f\navg turnaround %.2f\navg waiting    %.2f\n", m.resp, m.tat, m.wait);
+}
+
+static int run_sweep(const Options& opt) {
+    std::vector<SweepResult> results = runSweep(opt.sweep_cfg);
+    for (auto& r : results)
+        std::printf("%-9s q=%-5d n=%-7d resp %10.2f +- %-8.2f tat %10.2f +- %-8.2f wait %10.2f +- %.2f\n",
+                    algorithmName(r.algorithm), r.quantum, r.size,
+                    r.mean.resp, r.ci.resp, r.mean.tat, r.ci.tat, r.mean.wait, r.ci.wait);
+    if (!writeSweepCsv(opt.out, results)) {
+        std::fprintf(stderr, "cannot write %s\n", opt.out.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static int run_basic(const Options& opt) {
+    int algo = find_name(opt.algo, basic_names, 8);
+    if (algo < 0) {
+        std::fprintf(stderr, "unknown policy %s\n", opt.algo.c_str());
+        return 2;
+    }
+
+    Scheduler sched(static_cast<Algorithm>(algo), opt.quantum);
+    sched.log_level = opt.log_level;
+    if (!opt.workload.empty()) {
+        std::unique_ptr<WorkloadSource> src = open_workload(opt.workload);
+        if (!src) {
+            std::fprintf(stderr, "cannot open %s\n", opt.workload.c_str());
+            return 1;
+        }
+        sched.tasks.clear();
+        sched.setWorkload(std::move(src));
+    } else if (opt.tasks > 0) {
+        sched.tasks = randomWorkload(opt.tasks, opt.seed);
+    }
+    const std::vector<Task> tasks = sched.tasks;
+
+    TimelineWriter writer;
+    if (!opt.timeline.empty()) {
+        if (!writer.open(opt.timeline)) {
+            std::fprintf(stderr, "cannot write %s\n", opt.timeline.c_str());
+            return 1;
+        }
+        sched.setTimelineOutput(&writer);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sched.run();
+    auto end = std::chrono::steady_clock::now();
+
+    std::uint64_t slices = sched.timeline().size();
+    if (!opt.timeline.empty()) {
+        if (!writer.close()) {
+            std::fprintf(stderr, "error writing %s\n", opt.timeline.c_str());
+            return 1;
+        }
+        slices = writer.size();
+    }
+    if (!sched.workload_error.empty()) {
+        std::fprintf(stderr, "%s: %s\n", opt.workload.c_str(), sched.workload_error.c_str());
+        return 1;
+    }
+    if (opt.print)
+        for (const auto& e : sched.timeline())
+            std::printf("%d %d %d\n", e.id, e.start_time, e.end_time);
+
+    std::printf("%s q=%d: %llu slices in %.3f ms\n", basic_names[algo], opt.quantum,
+                static_cast<unsigned long long>(slices),
+                std::chrono::duration<double, std::milli>(end - start).count());
+    if (opt.workload.empty() && !tasks.empty()) {
+        if (opt.timeline.empty()) {
+            print_metrics(timelineMetrics(tasks, sched.timeline()));
+        } else {
+            TimelineReader reader;
+            if (!reader.open(opt.timeline)) {
+                std::fprintf(stderr, "%s: %s\n", opt.timeline.c_str(), reader.error().c_str());
+                return 1;
+            }
+            print_metrics(timelineMetrics(tasks, reader));
+        }
+    }
+    return 0;
+}
+
+static int run_threaded(const Options& opt) {
+    int algo = find_name(opt.algo, threaded_names, 5);
+    if (algo < 0) {
+        std::fprintf(stderr, "unknown threaded policy %s\n", opt.algo.c_str());
+        return 2;
+    }
+    if (!opt.workload.empty() || !opt.timeline.empty()) {
+        std::fprintf(stderr, "--workload and --timeline apply to the basic scheduler only\n");
+        return 2;
+    }
+
+    scheduler_fiber = ult_convert_thread();
+    if (!scheduler_fiber) {
+        std::fprintf(stderr, "ult_convert_thread failed\n");
+        return 1;
+    }
+
+    ThreadedScheduler ts(static_cast<ThreadedAlgorithm>(algo), opt.quantum);
+    ts.log_level = opt.log_level;
+    ts.workers = opt.workers;
+    ts.work_ms = opt.work_ms;
+    ts.preempt_us = opt.preempt_us;
+    if (opt.tasks > 0) {
+        ts.tasks.clear();
+        for (const Task& t : randomWorkload(opt.tasks, opt.seed))
+            ts.tasks.add(t.id, t.priority, t.remaining_time, t.arrival_time);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ts.run();
+    auto end = std::chrono::steady_clock::now();
+    ult_convert_back();
+
+    if (opt.print)
+        for (const auto& e : ts.timeline())
+            std::printf("%d %d %d %d\n", e.id, e.start_time, e.end_time, e.worker);
+    std::printf("T_%s q=%d workers=%d: %zu slices in %.3f ms\n", threaded_names[algo], opt.quantum,
+                opt.workers, ts.timeline().size(),
+                std::chrono::duration<double, std::milli>(end - start).count());
+    if (opt.preempt_us > 0)
+        std::printf("%ld slices ended by the preemption timer\n", ts.preempted);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (opt.sweep) return run_sweep(opt);
+    return opt.threaded ? run_threaded(opt) : run_basic(opt);
+}
@@ -0,0 +1,192 @@
+"""ctypes binding for libscheduler (cpp_scheduler/scheduler.cpp).
+
+Each Engine owns its own engine handle, so a process can create many and
+run them concurrently from different Python threads (ctypes drops the GIL
+for the duration of run()).
+
+Task state is read straight out of the engine's shared record table
+(get_thread_state_table), so polling costs no copies on the C++ side and
+no string parsing here. With numpy, StateView.array() is a zero-copy
+structured array over the records and StateView.snapshot() a consistent
+copy of it; without numpy the same calls return ctypes arrays.
+"""
+import ctypes
+import os
+
+try:
+    import numpy as np
+except ImportError:  # numpy is optional
+    np = None
+
+THREAD_STATE_ABI_VERSION = 1
+
+READY, RUNNING, FINISHED = 0, 1, 2
+STATE_NAMES = {READY: 'Ready', RUNNING: 'Running', FINISHED: 'Finished'}
+
+FCFS, RR, PRIORITY = 0, 1, 2
+
+
+# must match ThreadStateRecord / ThreadStateTable in scheduler.cpp
+class ThreadStateRecord(ctypes.Structure):
+    _fields_ = [
+        ('seq', ctypes.c_uint32),
+        ('id', ctypes.c_int32),
+        ('state', ctypes.c_int32),
+        ('base_priority', ctypes.c_int32),
+        ('dynamic_priority', ctypes.c_int32),
+        ('cpu_time', ctypes.c_int32),
+        ('remaining_work', ctypes.c_int32),
+        ('dispatches', ctypes.c_uint32),
+    ]
+
+
+class ThreadStateTable(ctypes.Structure):
+    _fields_ = [
+        ('abi_version', ctypes.c_uint32),
+        ('record_size', ctypes.c_uint32),
+        ('generation', ctypes.c_uint64),
+        ('version', ctypes.c_uint64),
+        ('count', ctypes.c_uint64),
+        ('capacity', ctypes.c_uint64),
+        ('records', ctypes.POINTER(ThreadStateRecord)),
+    ]
+
+
+def load_library(path=None):
+    """Load libscheduler: path, $SCHEDULER_LIB, or the copy next to this file."""
+    if path is None:
+        path = os.environ.get('SCHEDULER_LIB') or os.path.join(
+            os.path.dirname(os.path.abspath(__file__)), 'libscheduler.so')
+    lib = ctypes.CDLL(path)
+    handle = ctypes.c_void_p
+    lib.scheduler_create.argtypes = [ctypes.c_int]
+    lib.scheduler_create.restype = handle
+    lib.scheduler_destroy.argtypes = [handle]
+    lib.scheduler_add_thread.argtypes = [handle, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.scheduler_set_workers.argtypes = [handle, ctypes.c_int]
+    lib.scheduler_run.argtypes = [handle]
+    lib.scheduler_thread_states.argtypes = [handle]
+    lib.scheduler_thread_states.restype = ctypes.c_char_p
+    lib.scheduler_state_table.argtypes = [handle]
+    lib.scheduler_state_table.restype = ctypes.POINTER(ThreadStateTable)
+    lib.scheduler_copy_thread_states.argtypes = [handle, ctypes.POINTER(ThreadStateRecord), ctypes.c_size_t]
+    lib.scheduler_copy_thread_states.restype = ctypes.c_size_t
+    # single-engine API
+    lib.init_scheduler.argtypes = [ctypes.c_int]
+    lib.add_thread.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.get_thread_states.restype = ctypes.c_char_p
+    lib.get_thread_state_table.restype = ctypes.POINTER(ThreadStateTable)
+    lib.copy_thread_states.argtypes = [ctypes.POINTER(ThreadStateRecord), ctypes.c_size_t]
+    lib.copy_thread_states.restype = ctypes.c_size_t
+    return lib
+
+
+class StateView:
+    """Reads the engine's task-state table without copying it.
+
+    Records are seqlocked one by one: a record whose seq is odd, or changed
+    while it was read, was being rewritten and is read again. The table is
+    re-mapped when its generation changes (it grew and moved).
+    """
+
+    def __init__(self, table):
+        """table: the POINTER(ThreadStateTable) from scheduler_state_table()."""
+        if not table:
+            raise RuntimeError('no engine')
+        self._table = table.contents
+        if self._table.abi_version != THREAD_STATE_ABI_VERSION or \
+                self._table.record_size != ctypes.sizeof(ThreadStateRecord):
+            raise RuntimeError('libscheduler state table ABI mismatch')
+        self._generation = None
+        self._count = -1
+        self._records = None
+
+    def version(self):
+        """Changes whenever any record does; poll this to skip idle reads."""
+        return self._table.version
+
+    def array(self):
+        """Live zero-copy view of all records (may tear while being written)."""
+        t = self._table
+        while True:
+            gen = t.generation
+            records = t.records
+            count = min(t.count, t.capacity)
+            if not gen & 1 and t.generation == gen:
+                break
+        if gen != self._generation or count != self._count:
+            if count == 0:
+                self._records = [] if np is None else np.zeros(0, dtype=np.dtype(ThreadStateRecord))
+            elif np is not None:
+                self._records = np.ctypeslib.as_array(records, shape=(count,))
+            else:
+                self._records = (ThreadStateRecord * count).from_address(
+                    ctypes.addressof(records.contents))
+            self._generation = gen
+            self._count = count
+        return self._records
+
+    def snapshot(self):
+        """Copy of all records, each one consistent."""
+        while True:
+            gen = self._table.generation
+            live = self.array()
+            if np is not None:
+                before = live['seq'].copy()
+                snap = live.copy()
+                bad = np.nonzero((before & 1) | (before != live['seq']))[0]
+                for i in bad:
+                    snap[i] = self._read_one(live, i)
+            else:
+                snap = (ThreadStateRecord * len(live))()
+                for i in range(len(live)):
+                    snap[i] = self._read_one(live, i)
+            if self._table.generation == gen:
+                return snap
+
+    @staticmethod
+    def _read_one(live, i):
+        while True:
+            seq = _field(live[i], 'seq')
+            rec = live[i].copy() if np is not None else ThreadStateRecord.from_buffer_copy(live[i])
+            if not seq & 1 and _field(live[i], 'seq') == seq:
+                return rec
+
+
+def _field(rec, name):
+    return int(rec[name]) if np is not None else getattr(rec, name)
+
+
+class Engine:
+    """One independent libscheduler engine."""
+
+    def __init__(self, algorithm=RR, lib=None, workers=0):
+        """workers: pool threads for run(); 0 means one per hardware thread."""
+        self.lib = lib or load_library()
+        self.handle = self.lib.scheduler_create(algorithm)
+        self.lib.scheduler_set_workers(self.handle, workers)
+        self.view = StateView(self.lib.scheduler_state_table(self.handle))
+
+    def add_thread(self, thread_id, base_priority, burst_quanta):
+        self.lib.scheduler_add_thread(self.handle, thread_id, base_priority, burst_quanta)
+
+    def run(self):
+        self.lib.scheduler_run(self.handle)
+
+    def states(self):
+        """[(id, state name, dynamic priority, cpu time)] for every task."""
+        return [(_field(r, 'id'), STATE_NAMES[_field(r, 'state')],
+                 _field(r, 'dynamic_priority'), _field(r, 'cpu_time'))
+                for r in self.view.snapshot()]
+
+    def close(self):
+        if self.handle:
+            self.view = None
+            self.lib.scheduler_destroy(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
@@ -0,0 +1,205 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <algorithm>
+#include <vector>
+#include "scheduler.h"
+#include "workload.h"
+
+// Discrete-event simulation core shared by every Scheduler policy.
+//
+// The kernel owns the clock, the task rows and the pending events; a policy
+// only owns its ready set. There are two kinds of event, a task arriving and
+// the running task's slice ending. Only the next arrival is read ahead, so
+// at most one of each is pending, and run() compares the two directly
+// instead of keeping an event queue. Every event due at an instant is
+// handled before the next dispatch, so simultaneous arrivals reach the
+// policy together, and when nothing is ready the clock jumps straight to
+// the next arrival.
+//
+// A policy derives from SimPolicy and provides
+//   bool empty() const          nothing is ready
+//   void enqueue(Handle h)      h is ready: it arrived, or a slice of it
+//                               ended with work left (after any arrivals
+//                               due at the same instant)
+//   Handle pick()               remove and return the task to run next
+// and may hide any of the SimPolicy defaults:
+//   on_arrival(h)               h arrived; called before its first enqueue
+//   slice(h)                    how long h runs when picked
+//   on_tick(h, start, end)      a slice of h ended; remaining_time has been
+//                               charged and the slice recorded
+//   on_complete(h, start, end)  h finished; its row is reused afterwards
+// SimKernel is a template over the policy, so none of these are virtual.
+
+class SimPolicy {
+public:
+    typedef TaskTable::Handle Handle;
+
+    explicit SimPolicy(Scheduler &sched) : sched(sched), table(sched.table) {}
+
+    void on_arrival(Handle) {}
+    // default: run to completion
+    int slice(Handle h) const { return table.remaining_time[h]; }
+    void on_tick(Handle, int, int) {}
+    void on_complete(Handle, int, int) {}
+
+protected:
+    Scheduler &sched;
+    TaskTable &table;
+};
+
+// Hands tasks to the kernel in arrival order and owns their rows in the
+// Scheduler's TaskTable. Without a workload every task is copied into the
+// table up front, so a handle is just the index into `tasks`; if `tasks` is
+// not sorted by arrival_time, the handles are stable-sorted once. With a
+// workload the table is a pool: arrivals are read from the stream one ahead
+// of time and a finished task gives its row back, so memory follows the
+// number of live tasks, not the trace length. A stream is taken in file
+// order.
+class ArrivalFeed {
+public:
+    typedef TaskTable::Handle Handle;
+
+    ArrivalFeed(TaskTable &table, const std::vector<Task> &tasks, WorkloadSource *src)
+        : table(table), src(src) {
+        table.clear();
+        if (src) {
+            ahead = src->next(lookahead);
+        } else {
+            table.reserve(tasks.size());
+            for (const Task &tk : tasks)
+                table.add(tk);
+            const std::vector<int> &at = table.arrival_time;
+            if (!std::is_sorted(at.begin(), at.end())) {
+                order.resize(at.size());
+                for (std::size_t i = 0; i < order.size(); ++i)
+                    order[i] = static_cast<Handle>(i);
+                std::stable_sort(order.begin(), order.end(),
+                                 [&at](Handle a, Handle b) { return at[a] < at[b]; });
+            }
+        }
+    }
+
+    bool pending() const { return src ? ahead : next < table.size(); }
+
+    // move the next pending task into a row and return its handle
+    Handle admit() {
+        if (!src)
+            return order.empty() ? next++ : order[next++];
+
+        Handle h;
+        if (!free_slots.empty()) {
+            h = free_slots.back();
+            free_slots.pop_back();
+            table.set(h, lookahead);
+        } else {
+            h = table.add(lookahead);
+        }
+        ahead = src->next(lookahead);
+        return h;
+    }
+
+    // the task behind h has finished and its row may be reused
+    void retire(Handle h) {
+        if (src)
+            free_slots.push_back(h);
+    }
+
+private:
+    TaskTable &table;
+    WorkloadSource *src;
+    Handle next = 0;
+    std::vector<Handle> order;     // arrival order of unsorted `tasks`
+    Task lookahead{};
+    bool ahead = false;
+    std::vector<Handle> free_slots;
+};
+
+template <typename Policy>
+class SimKernel {
+public:
+    typedef TaskTable::Handle Handle;
+
+    SimKernel(Scheduler &sched, Policy &policy)
+        : sched(sched), table(sched.table), policy(policy),
+          feed(sched.table, sched.tasks, sched.workload.get()) {}
+
+    void run() {
+        // The clock and both pending events are locals: policy and table
+        // stores go through pointers that could alias members, which would
+        // force a reload of each after every store.
+        int now = 0;
+        bool arriving = false;          // the next arrival, already admitted
+        Handle arrival = 0;
+        int arrival_time = 0;
+        bool running = false;           // the running slice
+        Handle current = 0;
+        int start = 0, slice_end = 0;
+
+        // only the next arrival is ever read ahead
+        auto next_arrival = [&] {
+            arriving = feed.pending();
+            if (arriving) {
+                arrival = feed.admit();
+                arrival_time = std::max(now, table.arrival_time[arrival]);
+            }
+        };
+        auto arrive = [&] {
+            policy.on_arrival(arrival);
+            policy.enqueue(arrival);
+            next_arrival();
+        };
+
+        next_arrival();
+        while (arriving || running) {
+            bool preempted = false;
+            if (running) {
+                // nothing is dispatched while it runs, so arrivals due before
+                // the slice ends are taken in one go, and a slice that ends
+                // at t is charged before the arrivals due at t
+                while (arriving && arrival_time < slice_end)
+                    arrive();
+                now = slice_end;
+                running = false;
+                table.remaining_time[current] -= now - start;
+                sched.record(table.id[current], start, now);
+                policy.on_tick(current, start, now);
+                if (table.remaining_time[current] > 0) {
+                    preempted = true;
+                } else {
+                    policy.on_complete(current, start, now);
+                    feed.retire(current);
+                }
+            } else {
+                now = arrival_time;
+            }
+            while (arriving && arrival_time == now)
+                arrive();
+
+            // everything due at this instant is in; a preempted task is
+            // requeued behind the arrivals
+            if (preempted)
+                policy.enqueue(current);
+            if (!running && !policy.empty()) {
+                current = policy.pick();
+                start = now;
+                slice_end = now + std::max(0, policy.slice(current));
+                running = true;
+            }
+        }
+    }
+
+private:
+    Scheduler &sched;
+    TaskTable &table;
+    Policy &policy;
+    ArrivalFeed feed;
+};
+
+// run `policy` over sched's tasks (or workload) from time 0
+template <typename Policy>
+void simulate(Scheduler &sched, Policy &policy) {
+    SimKernel<Policy>(sched, policy).run();
+}
+
+#endif // SIM_KERNEL_H
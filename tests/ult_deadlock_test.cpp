@@ -0,0 +1,99 @@
+// ult_deadlock_test.cpp
+// Two ULTs take two ULTMutexes in opposite order. With
+// ULT_DEADLOCK_REPORT the cycle is counted and both stay blocked; with
+// ULT_DEADLOCK_REVOKE it is broken and both finish, for every victim rule.
+// The last case runs the ULTs on two OS threads, so that (on more than one
+// core) locks are also won on lock_slow()'s spin path, which must record
+// the owner like the others.
+
+#include "ult_test.h"
+
+// A: m0 then m1, B: m1 then m0, `rounds` times; each yields in between so
+// a single thread interleaves them into the deadlock
+static void spawn_crossed(ULTTestRun& run, ULTMutex& m0, ULTMutex& m1, long& inside, int rounds) {
+    run.spawn([&m0, &m1, &inside, rounds] {
+        for (int r = 0; r < rounds; ++r) {
+            m0.lock();
+            ult_yield();
+            m1.lock();
+            ++inside;
+            m1.unlock();
+            m0.unlock();
+            ult_yield();
+        }
+    });
+    run.spawn([&m0, &m1, &inside, rounds] {
+        for (int r = 0; r < rounds; ++r) {
+            m1.lock();
+            ult_yield();
+            m0.lock();
+            ++inside;
+            m0.unlock();
+            m1.unlock();
+            ult_yield();
+        }
+    });
+}
+
+static void test_report() {
+    ult_deadlock_configure(ULT_DEADLOCK_REPORT);
+    ult_deadlock_reset_stats();
+    ULTMutex m0, m1;
+    long inside = 0;
+    ULTTestRun run;
+    spawn_crossed(run, m0, m1, inside, 1);
+
+    CHECK(!run.run(1, 200));
+    ULTDeadlockStats st = ult_deadlock_stats();
+    CHECK(inside == 0);
+    CHECK(st.cycles == 1);
+    CHECK(st.last_cycle_len == 2);
+    CHECK(st.revocations == 0);
+}
+
+static void test_revoke(ULTDeadlockVictim victim) {
+    ult_deadlock_configure(ULT_DEADLOCK_REVOKE, victim);
+    ult_deadlock_reset_stats();
+    ULTMutex m0, m1;
+    long inside = 0;
+    ULTTestRun run;
+    spawn_crossed(run, m0, m1, inside, 20);
+
+    CHECK(run.run(1));
+    ULTDeadlockStats st = ult_deadlock_stats();
+    CHECK(inside == 40);
+    CHECK(st.cycles >= 1);
+    CHECK(st.revocations == st.cycles);
+    CHECK(st.last_cycle_len == 2);
+    if (victim == ULT_VICTIM_YOUNGEST) CHECK(st.last_victim == 1);
+    if (victim == ULT_VICTIM_OLDEST) CHECK(st.last_victim == 0);
+}
+
+// a missed owner hides the cycle, and then both ULTs stall for good
+static void test_revoke_threads() {
+    ult_deadlock_configure(ULT_DEADLOCK_REVOKE);
+    ult_deadlock_reset_stats();
+    ULTMutex m0, m1;
+    long inside = 0;
+    ULTTestRun run;
+    spawn_crossed(run, m0, m1, inside, 5000);
+
+    CHECK(run.run(2, 2000));
+    ULTDeadlockStats st = ult_deadlock_stats();
+    CHECK(inside == 10000);
+    CHECK(st.revocations == st.cycles);
+}
+
+int main() {
+    test_report();
+    test_revoke(ULT_VICTIM_REQUESTER);
+    test_revoke(ULT_VICTIM_YOUNGEST);
+    test_revoke(ULT_VICTIM_OLDEST);
+    test_revoke_threads();
+    ult_deadlock_configure(ULT_DEADLOCK_REPORT);
+    if (ult_test_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", ult_test_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+// ult_preempt_test.cpp
+// The preemption timer takes the CPU back from a ULT that never yields or
+// polls, also after the ULT moved to another OS thread; a tick that fires
+// while the ULT holds a ULTMutex waits for its unlock(); and SIGURGs that
+// are not ticks still reach the handler that was there before. Preempted
+// M:N runs on several workers all finish.
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+#include "analysis.h"
+#include "threadedscheduler.h"
+#include "ult_preempt.h"
+#include "ult_test.h"
+
+static const long SLICE_US = 500;
+
+static volatile unsigned long spins = 0;
+static volatile int stage = 0;
+static volatile bool overran = false;
+static std::chrono::steady_clock::time_point slice_start;
+static ULTMutex held;
+
+// never yields or polls, unless the timer has clearly failed to stop it
+static void hog(void*) {
+    for (;;) {
+        if ((++spins & 0xffff) == 0 &&
+            std::chrono::steady_clock::now() - slice_start > std::chrono::seconds(1)) {
+            overran = true;
+            ult_yield();
+        }
+    }
+}
+
+// holds the mutex well past its slice, then spins unlocked
+static void hog_locked(void*) {
+    held.lock();
+    auto t0 = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(5)) ++spins;
+    stage = 1;
+    held.unlock();
+    stage = 2;
+    for (;;) ++spins;
+}
+
+// one timed slice of `f` on the calling thread: did the tick end it?
+static bool timed_slice(ULTFiber f, std::size_t idx) {
+    unsigned long before = spins;
+    overran = false;
+    slice_start = std::chrono::steady_clock::now();
+    g_current_idx = idx;
+    ult_preempt_arm(SLICE_US);
+    ult_switch_to(f);
+    bool ticked = ult_preempt_pending();
+    ult_preempt_disarm();
+    return ticked && !overran && spins != before;
+}
+
+static void test_hog(ULTFiber f) {
+    for (int i = 0; i < 20; ++i)
+        CHECK(timed_slice(f, 0));
+}
+
+// resumed on another OS thread, inside the handler it was stopped in
+static void test_migrate(ULTFiber f) {
+    bool ok = false;
+    std::thread other([&] {
+        scheduler_fiber = ult_convert_thread();
+        ok = ult_preempt_thread_init() && timed_slice(f, 0) && timed_slice(f, 0);
+        ult_preempt_thread_exit();
+        ult_convert_back();
+    });
+    other.join();
+    CHECK(ok);
+    CHECK(timed_slice(f, 0));
+}
+
+static void test_deferred() {
+    ULTFiber f = ult_create_fiber(ULT_STACK_SIZE, hog_locked, nullptr);
+    CHECK(timed_slice(f, 1));
+    CHECK(stage == 1);      // switched out in unlock(), not before
+    ult_delete_fiber(f);
+}
+
+// Many short M:N runs: ULTs stopped by a tick just as they start their
+// slice, or resumed to drain without a timer, must not spin on. A hung run
+// fails the test by the watchdog instead of hanging it.
+static void test_mn_stress() {
+    std::atomic<bool> done(false);
+    std::thread watchdog([&] {
+        auto t0 = std::chrono::steady_clock::now();
+        while (!done.load()) {
+            if (std::chrono::steady_clock::now() - t0 > std::chrono::seconds(60)) {
+                std::fprintf(stderr, "M:N stress run hung\n");
+                std::_Exit(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+    for (unsigned seed = 1; seed <= 40; ++seed) {
+        ThreadedScheduler ts(static_cast<ThreadedAlgorithm>(seed % 5), 50,
+                             [](const std::string&) {});
+        ts.workers = 2 + static_cast<int>(seed % 6);
+        ts.preempt_us = 50;
+        ts.tasks.clear();
+        for (const Task& t : randomWorkload(40, seed))
+            ts.tasks.add(t.id, t.priority, t.remaining_time, t.arrival_time);
+        ts.run();
+        CHECK(ts.preempted > 0);
+    }
+    done = true;
+    watchdog.join();
+}
+
+static int foreign = 0;
+static void previous_handler(int) { ++foreign; }
+
+int main() {
+    if (!ult_preempt_supported()) return 0;
+    std::signal(SIGURG, previous_handler);
+    g_contexts.assign(2, ULTContext());
+    scheduler_fiber = ult_convert_thread();
+    CHECK(ult_preempt_thread_init());
+
+    ULTFiber f = ult_create_fiber(ULT_STACK_SIZE, hog, nullptr);
+    test_hog(f);
+    test_migrate(f);
+    ult_delete_fiber(f);
+    test_deferred();
+    test_mn_stress();
+
+    std::raise(SIGURG);
+    CHECK(foreign == 1);
+
+    ult_preempt_thread_exit();
+    ult_convert_back();
+    if (ult_test_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", ult_test_failures);
+        return 1;
+    }
+    return 0;
+}
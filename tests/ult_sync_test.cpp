@@ -0,0 +1,221 @@
+// ult_sync_test.cpp
+// ULTSemaphore, ULTRWLock, ULTBarrier and ULTChannel, each on one OS
+// thread (a deterministic interleaving) and on two (real contention).
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "ult_test.h"
+
+// bounded buffer: `slots` counts free places, `items` filled ones
+static void test_semaphore(int threads) {
+    const int PRODUCERS = 3, CONSUMERS = 3, PER_PRODUCER = 200, CAPACITY = 4;
+    ULTSemaphore slots(CAPACITY), items(0);
+    ULTMutex m;
+    std::vector<int> buf;
+    long consumed = 0, sum = 0;
+    int max_fill = 0;
+
+    ULTTestRun run;
+    for (int p = 0; p < PRODUCERS; ++p)
+        run.spawn([&, p] {
+            for (int i = 1; i <= PER_PRODUCER; ++i) {
+                slots.acquire();
+                m.lock();
+                buf.push_back(p * PER_PRODUCER + i);
+                max_fill = std::max(max_fill, static_cast<int>(buf.size()));
+                m.unlock();
+                items.release();
+                if (i % 7 == 0) ult_yield();
+            }
+        });
+    for (int c = 0; c < CONSUMERS; ++c)
+        run.spawn([&] {
+            for (int i = 0; i < PRODUCERS * PER_PRODUCER / CONSUMERS; ++i) {
+                items.acquire();
+                m.lock();
+                sum += buf.back();
+                buf.pop_back();
+                ++consumed;
+                m.unlock();
+                slots.release();
+                if (i % 5 == 0) ult_yield();
+            }
+        });
+
+    CHECK(run.run(threads));
+    const long n = PRODUCERS * PER_PRODUCER;
+    CHECK(consumed == n);
+    CHECK(sum == n * (n + 1) / 2);
+    CHECK(buf.empty());
+    CHECK(max_fill <= CAPACITY);
+    CHECK(slots.value() == CAPACITY);
+    CHECK(items.value() == 0);
+}
+
+// readers and writers inside at once are counted; a writer must be alone
+static void test_rwlock_exclusion(int threads) {
+    ULTRWLock rw;
+    std::atomic<int> readers_in{0}, writers_in{0};
+    std::atomic<int> bad{0};
+    long a = 0, b = 0;      // written together, under the write lock
+
+    ULTTestRun run;
+    for (int w = 0; w < 2; ++w)
+        run.spawn([&] {
+            for (int i = 0; i < 200; ++i) {
+                rw.lock();
+                if (writers_in.fetch_add(1) != 0 || readers_in.load() != 0) ++bad;
+                ++a;
+                ult_yield();
+                ++b;
+                writers_in.fetch_sub(1);
+                rw.unlock();
+            }
+        });
+    for (int r = 0; r < 4; ++r)
+        run.spawn([&] {
+            for (int i = 0; i < 200; ++i) {
+                rw.lock_shared();
+                readers_in.fetch_add(1);
+                if (writers_in.load() != 0 || a != b) ++bad;
+                ult_yield();
+                if (writers_in.load() != 0 || a != b) ++bad;
+                readers_in.fetch_sub(1);
+                rw.unlock_shared();
+            }
+        });
+
+    CHECK(run.run(threads));
+    CHECK(bad.load() == 0);
+    CHECK(a == 400 && b == 400);
+}
+
+// R1 holds a read lock while W queues, then R2 arrives: R2 must wait for W
+static void test_rwlock_writer_preference() {
+    ULTRWLock rw;
+    std::string order;
+
+    ULTTestRun run;
+    run.spawn([&] {
+        rw.lock_shared();
+        order += "R1 ";
+        ult_yield();        // W and R2 queue up meanwhile
+        ult_yield();
+        CHECK(!rw.try_lock_shared());
+        rw.unlock_shared();
+    });
+    run.spawn([&] {
+        rw.lock();
+        order += "W ";
+        rw.unlock();
+    });
+    run.spawn([&] {
+        rw.lock_shared();
+        order += "R2 ";
+        rw.unlock_shared();
+    });
+
+    CHECK(run.run(1));
+    CHECK(order == "R1 W R2 ");
+}
+
+// every round, nobody passes before all have arrived, and one ULT leads
+static void test_barrier(int threads) {
+    const int PARTIES = 4, ROUNDS = 50;
+    ULTBarrier barrier(PARTIES);
+    std::atomic<int> arrived{0};
+    std::vector<std::atomic<int>> leaders(ROUNDS);
+    std::atomic<int> early{0};
+
+    ULTTestRun run;
+    for (int p = 0; p < PARTIES; ++p)
+        run.spawn([&, p] {
+            for (int r = 0; r < ROUNDS; ++r) {
+                arrived.fetch_add(1);
+                if ((r + p) % 3 == 0) ult_yield();
+                if (barrier.arrive_and_wait()) leaders[r].fetch_add(1);
+                if (arrived.load() < (r + 1) * PARTIES) early.fetch_add(1);
+                // hold the next round until this one is checked everywhere
+                barrier.arrive_and_wait();
+            }
+        });
+
+    CHECK(run.run(threads));
+    CHECK(early.load() == 0);
+    for (int r = 0; r < ROUNDS; ++r)
+        CHECK(leaders[r].load() == 1);
+}
+
+// a full channel parks the sender; after close() the receiver still gets
+// everything that was sent, in order, and only then fails
+static void test_channel_close_drains() {
+    ULTChannel<std::string> ch(3);
+    std::vector<std::string> got;
+    bool sent_after_close = true;
+
+    ULTTestRun run;
+    run.spawn([&] {
+        for (int i = 0; i < 10; ++i)
+            CHECK(ch.send(std::to_string(i)));
+        ch.close();
+        sent_after_close = ch.send("late");
+    });
+    run.spawn([&] {
+        for (int i = 0; i < 3; ++i) ult_yield();    // let the sender fill it
+        std::string v;
+        while (ch.recv(v)) got.push_back(v);
+        CHECK(!ch.try_recv(v));
+    });
+
+    CHECK(run.run(1));
+    CHECK(!sent_after_close);
+    CHECK(got.size() == 10);
+    for (std::size_t i = 0; i < got.size(); ++i)
+        CHECK(got[i] == std::to_string(i));
+}
+
+// several producers and consumers; the last producer out closes it
+static void test_channel_mpmc(int threads) {
+    const int PRODUCERS = 2, CONSUMERS = 3, PER_PRODUCER = 300;
+    ULTChannel<int> ch(2);
+    std::atomic<int> producing{PRODUCERS};
+    std::atomic<long> received{0}, sum{0};
+
+    ULTTestRun run;
+    for (int p = 0; p < PRODUCERS; ++p)
+        run.spawn([&, p] {
+            for (int i = 1; i <= PER_PRODUCER; ++i)
+                ch.send(p * PER_PRODUCER + i);
+            if (producing.fetch_sub(1) == 1) ch.close();
+        });
+    for (int c = 0; c < CONSUMERS; ++c)
+        run.spawn([&] {
+            int v;
+            while (ch.recv(v)) {
+                received.fetch_add(1);
+                sum.fetch_add(v);
+            }
+        });
+
+    CHECK(run.run(threads));
+    const long n = PRODUCERS * PER_PRODUCER;
+    CHECK(received.load() == n);
+    CHECK(sum.load() == n * (n + 1) / 2);
+}
+
+int main() {
+    for (int threads = 1; threads <= 2; ++threads) {
+        test_semaphore(threads);
+        test_rwlock_exclusion(threads);
+        test_barrier(threads);
+        test_channel_mpmc(threads);
+    }
+    test_rwlock_writer_preference();
+    test_channel_close_drains();
+    if (ult_test_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", ult_test_failures);
+        return 1;
+    }
+    return 0;
+}
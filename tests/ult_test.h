@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "ult_context.h"
+#include "ult_sync.h"
+
+// Shared by the ULT primitive tests: a bare cooperative runtime. Each of
+// `threads` OS threads resumes its share of the ULTs round-robin, in
+// ult_sync.h's single-worker mode: a parked ULT is skipped until it is
+// woken, from whichever thread. A run that makes no progress for a while
+// is reported as stuck, which is how a test sees a deadlock.
+
+#define CHECK(cond)                                                       \
+    do {                                                                  \
+        if (!(cond)) {                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,   \
+                         __LINE__, #cond);                                \
+            ++ult_test_failures;                                          \
+        }                                                                 \
+    } while (0)
+
+static int ult_test_failures = 0;
+
+class ULTTestRun {
+public:
+    // add a ULT; bodies run in the order they were added on each thread
+    void spawn(std::function<void()> body) { bodies.push_back(std::move(body)); }
+
+    // Run every ULT to its end. False if they stopped making progress for
+    // `stall_ms` with some still blocked; those stay unfinished.
+    bool run(int threads = 1, int stall_ms = 500) {
+        self = this;
+        stall = std::chrono::milliseconds(stall_ms);
+        touch();
+        g_contexts.assign(bodies.size(), ULTContext());
+        for (std::size_t i = 0; i < bodies.size(); ++i)
+            g_contexts[i].fiber = ult_create_fiber(ULT_STACK_SIZE, entry, reinterpret_cast<void*>(i));
+
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; ++t)
+            pool.emplace_back([this, t, threads] { worker(t, threads); });
+        worker(0, threads);
+        for (auto& th : pool)
+            th.join();
+
+        bool done = true;
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+            done = done && g_contexts[i].finished;
+            ult_delete_fiber(g_contexts[i].fiber);
+            g_contexts[i].fiber = nullptr;
+        }
+        bodies.clear();
+        return done;
+    }
+
+private:
+    static void entry(void* arg) {
+        std::size_t idx = reinterpret_cast<std::size_t>(arg);
+        self->bodies[idx]();
+        g_contexts[idx].finished = true;
+        g_contexts[idx].park.store(ULT_EXITED, std::memory_order_release);
+        ult_yield();
+    }
+
+    void worker(int t, int threads) {
+        scheduler_fiber = ult_convert_thread();
+        for (;;) {
+            bool left = false, ran = false;
+            for (std::size_t i = t; i < bodies.size(); i += threads) {
+                ULTContext& ctx = g_contexts[i];
+                if (ctx.finished) continue;
+                left = true;
+                if (ctx.park.load(std::memory_order_acquire) == ULT_PARKED) continue;
+                g_current_idx = i;
+                ult_switch_to(ctx.fiber);
+                ult_park_commit(i);
+                ran = true;
+            }
+            if (!left) break;
+            if (ran) {
+                touch();
+            } else {
+                if (stuck()) break;
+                std::this_thread::yield();
+            }
+        }
+        ult_convert_back();
+    }
+
+    void touch() {
+        last_progress.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                            std::memory_order_relaxed);
+    }
+    bool stuck() const {
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        return now - last_progress.load(std::memory_order_relaxed) >
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(stall).count();
+    }
+
+    static ULTTestRun* self;
+    std::vector<std::function<void()>> bodies;
+    std::chrono::milliseconds stall{500};
+    std::atomic<long long> last_progress{0};
+};
+
+ULTTestRun* ULTTestRun::self = nullptr;
@@ -1,15 +1,14 @@
 
 #include "threadcontrol.h"
-#include <windows.h>
 #include <vector>
 #include <cstddef>
 #include "ult_context.h"
-extern void* scheduler_fiber;
-extern size_t g_current_idx;
+extern thread_local ULTFiber scheduler_fiber;
+extern thread_local size_t g_current_idx;
 extern std::vector<ULTContext> g_contexts;
 
 void ThreadControl::waitUntilRunnable() {
-    SwitchToFiber(scheduler_fiber);
+    ult_yield();
 }
 
 void ThreadControl::finish() {
@@ -6,8 +6,8 @@
 #include "ult_context.h" // Include for ULTContext struct definition
 
 // Forward declarations of global variables used by the Fiber-based ULT system
-extern void* scheduler_fiber;
-extern size_t g_current_idx;
+extern thread_local ULTFiber scheduler_fiber;
+extern thread_local size_t g_current_idx;
 extern std::vector<ULTContext> g_contexts;
 
 class ThreadControl {
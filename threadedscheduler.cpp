@@ -1,172 +1,284 @@
-#define WIN32_LEAN_AND_MEAN
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-#include <windows.h>
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <queue>
-#include <numeric>
+#include <thread>
+#include <chrono>
 #include "ult_context.h"  
 #include "ult_sync.h"
+#include "ult_preempt.h"
 #include "threadedscheduler.h" 
-#include <QDebug>   
+#include "arrival_queue.h"
+#include "run_queue.h"
 
 
-LPVOID scheduler_fiber = nullptr;
+thread_local ULTFiber scheduler_fiber = nullptr;
 std::vector<ULTContext> g_contexts;
-size_t g_current_idx = 0;
+thread_local size_t g_current_idx = 0;
 std::deque<size_t> ready_queue;
 ThreadedScheduler* g_sched_ptr = nullptr;
 
-static ULTMutex shared_mtx;
-static ULTCondVar shared_cv;
-static bool data_ready = false;
-static int shared_counter = 0;
+// state the demo ULTs share, rebuilt for every run so no ULT of an earlier
+// run is left on its wait lists
+struct SharedDemo {
+    ULTMutex mtx;
+    ULTCondVar cv;
+    bool data_ready = false;
+    int counter = 0;
+};
+static std::unique_ptr<SharedDemo> g_demo;
 
+// ULT events; like the rest of the demo's ULT output they go to stdout
+enum UltEvent : std::uint16_t { EV_ULT_START, EV_ULT_COUNTER, EV_ULT_END };
 
-static void __stdcall task_trampoline(void* arg) {
+
+static void task_trampoline(void* arg) {
     size_t idx = reinterpret_cast<size_t>(arg);
     ULTContext& ctx = g_contexts[idx];
-    auto& tk = g_sched_ptr->tasks[idx];
+    const int id = g_sched_ptr->tasks.id[idx];
 
     // initial handshake: yield back so scheduler records start
-    SwitchToFiber(scheduler_fiber);
+    ult_yield();
 
+    SharedDemo& shared = *g_demo;
     if (idx == 0) {
-        shared_mtx.lock();
-        data_ready = true;
-        shared_cv.broadcast();
-        shared_mtx.unlock();
+        shared.mtx.lock();
+        shared.data_ready = true;
+        shared.cv.broadcast();
+        shared.mtx.unlock();
     } else {
-        shared_mtx.lock();
-        while (!data_ready) shared_cv.wait(shared_mtx);
-        shared_mtx.unlock();
+        // parks until ULT 0 has run; meanwhile the policy's slices for it
+        // pass without switching to it
+        shared.mtx.lock();
+        while (!shared.data_ready) shared.cv.wait(shared.mtx);
+        shared.mtx.unlock();
     }
 
-    // run until finished flag set by scheduler
+    // run until finished flag set by scheduler. Under the preemption timer
+    // the trace calls, which may flush the log, run with it held off.
+    const bool traced = SCHED_LOG_ON(LOG_DEBUG, g_sched_ptr->log_level);
     while (!ctx.finished) {
-        std::cout << "[ULT " << tk->id << "] slice start" << std::endl;
+        if (traced) {
+            ult_preempt_disable();
+            g_sched_ptr->trace(EV_ULT_START, id);
+            ult_preempt_enable();
+        }
 
         // CRITICAL SECTION
-        shared_mtx.lock();
-        ++shared_counter;
-        std::cout << " [shared_counter=" << shared_counter << "]" << std::endl;
-        shared_mtx.unlock();
-
-        // simulate work
-        Sleep(30);
-
-        std::cout << "[ULT " << tk->id << "] slice end" << std::endl;
+        shared.mtx.lock();
+        ++shared.counter;
+        if (traced) g_sched_ptr->trace(EV_ULT_COUNTER, id, 0, 0, shared.counter);
+        shared.mtx.unlock();
+
+        // simulate work: compute until the timer switches us out, or sleep
+        bool preempted = false;
+        if (g_sched_ptr->preempt_us > 0)
+            preempted = ult_spin_until_tick();
+        else if (g_sched_ptr->work_ms > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(g_sched_ptr->work_ms));
+
+        if (traced) {
+            ult_preempt_disable();
+            g_sched_ptr->trace(EV_ULT_END, id);
+            ult_preempt_enable();
+        }
 
-        // yield back to scheduler for next slice
-        SwitchToFiber(scheduler_fiber);
+        // yield back to scheduler for next slice, unless the timer did
+        if (!preempted) ult_yield();
     }
 
     // notify scheduler of exit
-    SwitchToFiber(scheduler_fiber);
+    ctx.park.store(ULT_EXITED, std::memory_order_relaxed);
+    ult_yield();
 }
 
-// Build ULT contexts (fibers)
+// Build ULT contexts. Fibers are created lazily on first dispatch, so only
+// ULTs that have arrived hold a stack.
 static void setup_contexts(ThreadedScheduler* sched) {
     g_sched_ptr = sched;
 
     size_t n = sched->tasks.size();
     g_contexts.resize(n);
 
-    for (size_t i = 0; i < n; ++i) {
-        g_contexts[i].finished = false;
-        g_contexts[i].fiber = CreateFiber(
-            ULT_STACK_SIZE,
+    for (size_t i = 0; i < n; ++i)
+        g_contexts[i] = ULTContext();
+    g_demo.reset(new SharedDemo());
+}
+
+// Helper to schedule one slice of `run` time units; with preemption on the
+// worker's timer is armed for the slice's wall-time budget
+inline void schedule_slice(size_t idx, int run = 0) {
+    ULTContext& ctx = g_contexts[idx];
+    if (!ctx.fiber) {
+        ctx.fiber = ult_create_fiber(
+            g_sched_ptr->tasks.stack_size[idx],
             task_trampoline,
-            reinterpret_cast<void*>(i)
+            reinterpret_cast<void*>(idx)
         );
-        if (!g_contexts[i].fiber) {
-            qFatal("CreateFiber failed for ULT %zu (error %u)", i, GetLastError());
+        if (!ctx.fiber) {
+            std::fprintf(stderr, "ult_create_fiber failed for ULT %zu\n", idx);
+            std::abort();
         }
     }
-}
-
-// Helper to schedule one slice
-inline void schedule_slice(size_t idx) {
+    // parked on a ULTMutex/ULTCondVar: the slice passes without it
+    if (ctx.park.load(std::memory_order_acquire) == ULT_PARKED) return;
     g_current_idx = idx;
+    long budget = g_sched_ptr->sliceBudgetUs(run);
+    if (budget > 0) ult_preempt_arm(budget);
     // switch into the ULT’s fiber
-    SwitchToFiber(g_contexts[idx].fiber);
+    ult_switch_to(ctx.fiber);
+    if (budget > 0) {
+        if (ult_preempt_pending()) ++g_sched_ptr->preempted;
+        ult_preempt_disarm();
+    }
+    ult_park_commit(idx);
+}
+
+// A finished ULT is not resumed for another slice, so its stack goes
+// straight back to the pool for the next ULT to arrive. The exception is a
+// ULT woken but not yet resumed: unlock() or a condition variable may have
+// handed it a mutex, so it first runs on to its exit to release it.
+static void retire_context(size_t idx) {
+    ULTContext& ctx = g_contexts[idx];
+    ctx.finished = true;
+    while (ctx.fiber && ctx.park.load(std::memory_order_acquire) == ULT_WOKEN) {
+        g_current_idx = idx;
+        ult_switch_to(ctx.fiber);
+        ult_park_commit(idx);
+    }
+    ctx.park.store(ULT_EXITED, std::memory_order_relaxed);
+    if (ctx.fiber) {
+        ult_delete_fiber(ctx.fiber);
+        ctx.fiber = nullptr;
+    }
 }
 
 ThreadedScheduler::ThreadedScheduler(ThreadedAlgorithm algo,
                                      int tq,
                                      Logger log)
-    : algorithm(algo), time_quantum(tq), logger(log) {
+    : algorithm(algo), time_quantum(tq), workers(1), logger(log) {
 
-    tasks.emplace_back(std::make_unique<ThreadedTask>(1, 5, 200, 0));
-    tasks.emplace_back(std::make_unique<ThreadedTask>(2, 3, 150, 50));
-    tasks.emplace_back(std::make_unique<ThreadedTask>(3, 8, 300, 100));
+    tasks.add(1, 5, 200, 0);
+    tasks.add(2, 3, 150, 50);
+    tasks.add(3, 8, 300, 100);
 }
 
-void ThreadedScheduler::log(const std::string& msg) {
+void ThreadedScheduler::log(const std::string& msg, LogLevel level) {
+    if (level > log_level) return;
+    flushLog();
+    write(msg);
+}
+
+void ThreadedScheduler::write(const std::string& msg) {
     if (logger) logger(msg);
     else std::cout << msg << std::endl;
 }
 
+void ThreadedScheduler::trace(std::uint16_t kind, int id, int start, int end, int arg) {
+    LogEvent ev = { kind, id, start, end, arg, 0.0 };
+    if (!events.push(ev)) {
+        flushLog();
+        events.push(ev);
+    }
+}
+
+void ThreadedScheduler::flushLog() {
+    bool wrote = events.drain([this](const LogEvent& ev) { emit(ev); }) != 0;
+    if (wrote) std::cout.flush();
+}
+
+void ThreadedScheduler::emit(const LogEvent& ev) {
+    switch (ev.kind) {
+        case EV_ULT_START:
+            std::cout << "[ULT " << ev.id << "] slice start\n";
+            break;
+        case EV_ULT_COUNTER:
+            std::cout << " [shared_counter=" << ev.arg << "]\n";
+            break;
+        case EV_ULT_END:
+            std::cout << "[ULT " << ev.id << "] slice end\n";
+            break;
+    }
+}
+
 const std::vector<ThreadedTimelineEntry>& ThreadedScheduler::timeline() const {
     return _timeline;
 }
 
 void ThreadedScheduler::run() {
-    // 1) build fiber contexts
-    setup_contexts(this);
-
-    // 2) invoke the chosen policy
-    switch (algorithm) {
-        case T_FCFS:     runFCFS();     break;
-        case T_RR:       runRR();       break;
-        case T_PRIORITY: runPriority(); break;
-        case T_MLFQ:     runMLFQ();     break;
-        case T_CFS:      runCFS();      break;
+    preempted = 0;
+    ult_deadlock_reset_stats();
+    if (preempt_us > 0 && !ult_preempt_supported())
+        log("[PREEMPT] no preemption timer on this platform", LOG_ERROR);
+
+    if (workers > 1) {
+        // M:N mode: worker threads build and drive the contexts themselves
+        runParallel();
+    } else {
+        // 1) build fiber contexts
+        setup_contexts(this);
+
+        // 2) invoke the chosen policy, under this thread's timer if preempting
+        if (preempt_us > 0 && ult_preempt_supported() && !ult_preempt_thread_init())
+            log("[PREEMPT] timer_create failed", LOG_ERROR);
+        switch (algorithm) {
+            case T_FCFS:     runFCFS();     break;
+            case T_RR:       runRR();       break;
+            case T_PRIORITY: runPriority(); break;
+            case T_MLFQ:     runMLFQ();     break;
+            case T_CFS:      runCFS();      break;
+        }
+        ult_preempt_thread_exit();
     }
-
-    // 3) Clean up worker fibers so repeated runs work
+    if (preempt_us > 0)
+        log("[PREEMPT] " + std::to_string(preempted) + " slices ended by the timer");
+    ULTDeadlockStats dl = ult_deadlock_stats();
+    if (dl.cycles > 0)
+        log("[DEADLOCK] " + std::to_string(dl.cycles) + " cycles found, " +
+            std::to_string(dl.revocations) + " locks revoked", LOG_ERROR);
+
+    // 3) Return leftover stacks to the pool so repeated runs reuse them
     for (auto &ctx : g_contexts) {
         if (ctx.fiber) {
-            DeleteFiber(ctx.fiber);
+            ult_delete_fiber(ctx.fiber);
             ctx.fiber = nullptr;
         }
     }
     g_contexts.clear();
+    g_demo.reset();
+    flushLog();
 }
 
 void ThreadedScheduler::runFCFS() {
     log("[FCFS] starting");
-    
+
     // initial dispatch into first ULT
     schedule_slice(0);
 
-    // sort by arrival
-    std::vector<size_t> order(tasks.size());
-    std::iota(order.begin(), order.end(), 0);
-    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
-        return tasks[a]->arrival_time < tasks[b]->arrival_time;
-    });
+    // tasks come out of the arrival queue in arrival order
+    ArrivalQueue arrivals(tasks.arrival_time);
 
     int current_time = 0;
-    for (auto idx : order) {
-        auto& tk = tasks[idx];
+    while (!arrivals.empty()) {
+        size_t idx = arrivals.pop();
         // wait until arrival
-        current_time = std::max(current_time, tk->arrival_time);
-        tk->state = ThreadState::RUNNING;
-        int slice = tk->remaining_time;
+        current_time = std::max(current_time, tasks.arrival_time[idx]);
+        tasks.state[idx] = ThreadState::RUNNING;
+        int slice = tasks.remaining_time[idx];
         // record timeline
-        _timeline.emplace_back(tk->id, current_time, current_time + slice, tk->state, tk->arrival_time);
+        _timeline.emplace_back(tasks.id[idx], current_time, current_time + slice, tasks.state[idx], tasks.arrival_time[idx]);
 
         // schedule one long slice
-        schedule_slice(idx);
+        schedule_slice(idx, slice);
 
         // mark finished
         current_time += slice;
-        tk->remaining_time = 0;
-        tk->state = ThreadState::FINISHED;
-        g_contexts[idx].finished = true;
+        tasks.remaining_time[idx] = 0;
+        tasks.state[idx] = ThreadState::FINISHED;
+        retire_context(idx);
     }
     log("[FCFS] done");
 }
@@ -177,39 +289,44 @@ void ThreadedScheduler::runRR() {
     schedule_slice(0);
     int current_time = 0;
     std::queue<size_t> q;
+    ArrivalQueue arrivals(tasks.arrival_time);
+    auto admit = [&](size_t i) { q.push(i); };
+
     // initially enqueue arrived tasks
-    for (size_t i = 0; i < tasks.size(); ++i)
-        if (tasks[i]->arrival_time == 0) q.push(i);
+    arrivals.admit_until(current_time, admit);
 
     // simple RR until all done
     int remaining = tasks.size();
     while (remaining > 0) {
-        if (q.empty()) { current_time++; continue; }
+        if (q.empty()) {
+            if (arrivals.empty()) break;
+            // idle: jump straight to the next arrival
+            current_time = arrivals.next_time();
+            arrivals.admit_until(current_time, admit);
+            continue;
+        }
         size_t idx = q.front(); q.pop();
-        auto& tk = tasks[idx];
-        if (tk->remaining_time <= 0) continue;
+        if (tasks.remaining_time[idx] <= 0) continue;
 
         // run one quantum or until finish
-        tk->state = ThreadState::RUNNING;
-        int run = std::min(tk->remaining_time, time_quantum);
-        _timeline.emplace_back(tk->id, current_time, current_time + run, tk->state, tk->arrival_time);
-        schedule_slice(idx);
+        tasks.state[idx] = ThreadState::RUNNING;
+        int run = std::min(tasks.remaining_time[idx], time_quantum);
+        _timeline.emplace_back(tasks.id[idx], current_time, current_time + run, tasks.state[idx], tasks.arrival_time[idx]);
+        schedule_slice(idx, run);
 
-        tk->remaining_time -= run;
+        tasks.remaining_time[idx] -= run;
         current_time += run;
 
-        if (tk->remaining_time > 0) {
-            tk->state = ThreadState::READY;
+        if (tasks.remaining_time[idx] > 0) {
+            tasks.state[idx] = ThreadState::READY;
             q.push(idx);
         } else {
-            tk->state = ThreadState::FINISHED;
-            g_contexts[idx].finished = true;
+            tasks.state[idx] = ThreadState::FINISHED;
+            retire_context(idx);
             --remaining;
         }
         // enqueue newly arrived tasks
-        for (size_t j = 0; j < tasks.size(); ++j)
-            if (tasks[j]->arrival_time > current_time - run && tasks[j]->arrival_time <= current_time)
-                q.push(j);
+        arrivals.admit_until(current_time, admit);
     }
     log("[RR] done");
 }
@@ -220,69 +337,68 @@ void ThreadedScheduler::runPriority() {
     schedule_slice(0);
 
     int current_time = 0;
-    const int AGING_INTERVAL = time_quantum; // age tasks every quantum
-    const int AGING_INCREMENT = 1;         // increase priority by 1 each interval
+    const int AGING_INCREMENT = 1;         // every ready task gains this per quantum
 
     // copy of original priorities to avoid unbounded growth
     std::vector<int> base_prio(tasks.size());
     for (size_t i = 0; i < tasks.size(); ++i) {
-        base_prio[i] = tasks[i]->priority;
+        base_prio[i] = tasks.priority[i];
     }
 
-    // track waiting time
-    std::vector<int> wait_time(tasks.size(), 0);
-    bool any;
-    do {
-        any = false;
-        // age waiting tasks
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            auto& tk = tasks[i];
-            if (tk->arrival_time <= current_time && tk->remaining_time > 0) {
-                // increment wait time
-                wait_time[i] += AGING_INTERVAL;
-                // if waited at least one interval, boost priority
-                if (wait_time[i] >= AGING_INTERVAL) {
-                    tasks[i]->priority += AGING_INCREMENT;
-                    wait_time[i] = 0;
-                }
-            }
-        }
+    // Aging is a global offset: all ready tasks age together, so a task
+    // admitted with priority p when the offset was a0 has effective priority
+    // p + (age - a0). The heap key (a0 - p, index) never changes while the
+    // task is ready, which makes aging O(1) per slice. It is packed into one
+    // int64, so the ready set can be the heap or a dense array scanned by
+    // the vectorised argmin.
+    long long age = 0;
+    const bool scan = pick_resolve(priority_pick, tasks.size()) == PICK_SCAN;
+    RunQueue<std::int64_t> heap(scan ? 0 : tasks.size());
+    ScanQueue<std::int64_t> dense(scan ? tasks.size() : 0);
+    ArrivalQueue arrivals(tasks.arrival_time);
+    auto push = [&](size_t i, std::int64_t key) {
+        if (scan) dense.push(static_cast<std::uint32_t>(i), key);
+        else heap.push(static_cast<std::uint32_t>(i), key);
+    };
+    auto admit = [&](size_t i) {
+        if (tasks.remaining_time[i] > 0)
+            push(i, pick_pack(age - tasks.priority[i], static_cast<std::int32_t>(i)));
+    };
 
-        // pick highest-priority ready task
-        size_t best_idx = 0;
-        int best_prio = -1;
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            auto& tk = tasks[i];
-            if (tk->arrival_time <= current_time && tk->remaining_time > 0) {
-                any = true;
-                if (tk->priority > best_prio) {
-                    best_prio = tk->priority;
-                    best_idx = i;
-                }
-            }
-        }
-        if (!any) {
-            current_time++;
+    while (true) {
+        arrivals.admit_until(current_time, admit);
+        if (scan ? dense.empty() : heap.empty()) {
+            if (arrivals.empty()) break;
+            // idle: jump straight to the next arrival
+            current_time = arrivals.next_time();
             continue;
         }
 
-        auto& tk = tasks[best_idx];
-        tk->state = ThreadState::RUNNING;
-        int run = std::min(tk->remaining_time, time_quantum);
-        _timeline.emplace_back(tk->id, current_time, current_time + run, tk->state, tk->arrival_time);
-        schedule_slice(best_idx);
+        // age waiting tasks
+        age += AGING_INCREMENT;
+
+        // pick highest-priority ready task (lowest index on ties)
+        std::int64_t key = scan ? dense.top_key() : heap.top_key();
+        size_t best_idx = scan ? dense.pop() : heap.pop();
 
-        tk->remaining_time -= run;
+        tasks.priority[best_idx] = static_cast<int>(age - pick_major(key));
+        tasks.state[best_idx] = ThreadState::RUNNING;
+        int run = std::min(tasks.remaining_time[best_idx], time_quantum);
+        _timeline.emplace_back(tasks.id[best_idx], current_time, current_time + run, tasks.state[best_idx], tasks.arrival_time[best_idx]);
+        schedule_slice(best_idx, run);
+
+        tasks.remaining_time[best_idx] -= run;
         current_time += run;
-        if (tk->remaining_time <= 0) {
-            tk->state = ThreadState::FINISHED;
-            g_contexts[best_idx].finished = true;
+        if (tasks.remaining_time[best_idx] <= 0) {
+            tasks.state[best_idx] = ThreadState::FINISHED;
+            retire_context(best_idx);
             // restore priority (optional)
-            tasks[best_idx]->priority = base_prio[best_idx];
+            tasks.priority[best_idx] = base_prio[best_idx];
         } else {
-            tk->state = ThreadState::READY;
+            tasks.state[best_idx] = ThreadState::READY;
+            push(best_idx, key);
         }
-    } while (any);
+    }
 
     log("[PRIORITY] done");
 }
@@ -294,10 +410,11 @@ void ThreadedScheduler::runMLFQ() {
     int current_time = 0;
     // Three levels: 0 (high) to 2 (low)
     std::vector<std::queue<size_t>> queues(3);
+    ArrivalQueue arrivals(tasks.arrival_time);
+    auto admit = [&](size_t i) { queues[0].push(i); };
 
     // initially enqueue arrivals at time 0 to queue 0
-    for (size_t i = 0; i < tasks.size(); ++i)
-        if (tasks[i]->arrival_time == 0) queues[0].push(i);
+    arrivals.admit_until(current_time, admit);
 
     int remaining = tasks.size();
     while (remaining > 0) {
@@ -306,29 +423,28 @@ void ThreadedScheduler::runMLFQ() {
         for (int l = 0; l < 3; ++l) {
             if (!queues[l].empty()) { level = l; break; }
         }
-        if (level < 0) { current_time++; // check new arrivals
-            for (size_t i = 0; i < tasks.size(); ++i)
-                if (tasks[i]->arrival_time == current_time) queues[0].push(i);
+        if (level < 0) {
+            if (arrivals.empty()) break;
+            // idle: jump straight to the next arrival
+            current_time = arrivals.next_time();
+            arrivals.admit_until(current_time, admit);
             continue;
         }
         size_t idx = queues[level].front(); queues[level].pop();
-        auto& tk = tasks[idx];
-        tk->state = ThreadState::RUNNING;
-        int run = std::min(tk->remaining_time, time_quantum << level);
-        _timeline.emplace_back(tk->id, current_time, current_time + run, tk->state, tk->arrival_time);
-        schedule_slice(idx);
-        tk->remaining_time -= run;
+        tasks.state[idx] = ThreadState::RUNNING;
+        int run = std::min(tasks.remaining_time[idx], time_quantum << level);
+        _timeline.emplace_back(tasks.id[idx], current_time, current_time + run, tasks.state[idx], tasks.arrival_time[idx]);
+        schedule_slice(idx, run);
+        tasks.remaining_time[idx] -= run;
         current_time += run;
         // enqueue new arrivals
-        for (size_t i = 0; i < tasks.size(); ++i)
-            if (tasks[i]->arrival_time > current_time - run && tasks[i]->arrival_time <= current_time)
-                queues[0].push(i);
-        if (tk->remaining_time <= 0) {
-            tk->state = ThreadState::FINISHED;
-            g_contexts[idx].finished = true;
+        arrivals.admit_until(current_time, admit);
+        if (tasks.remaining_time[idx] <= 0) {
+            tasks.state[idx] = ThreadState::FINISHED;
+            retire_context(idx);
             --remaining;
         } else {
-            tk->state = ThreadState::READY;
+            tasks.state[idx] = ThreadState::READY;
             // demote to lower queue unless already lowest
             int next_level = std::min(level + 1, 2);
             queues[next_level].push(idx);
@@ -342,10 +458,10 @@ void ThreadedScheduler::runCFS() {
 
     //Initialize vruntime & weights, and initial dispatch
     const double DEFAULT_WEIGHT = 1024.0;
-    for (auto &tk_ptr : tasks) {
-        tk_ptr->weight   = DEFAULT_WEIGHT / (1 << tk_ptr->nice);
-        tk_ptr->vruntime = 0.0;
-        tk_ptr->state    = ThreadState::NEW;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks.weight[i]   = DEFAULT_WEIGHT / (1 << tasks.nice[i]);
+        tasks.vruntime[i] = 0.0;
+        tasks.state[i]    = ThreadState::NEW;
     }
     schedule_slice(0);
 
@@ -353,57 +469,69 @@ void ThreadedScheduler::runCFS() {
     int remaining    = static_cast<int>(tasks.size());
 
     auto cmp = [&](size_t a, size_t b) {
-        return tasks[a]->vruntime > tasks[b]->vruntime;
+        return tasks.vruntime[a] > tasks.vruntime[b];
     };
     std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> run_queue(cmp);
+    // vruntime only changes while a task runs, so a dense copy of the keys
+    // stays valid while it waits
+    const bool scan = pick_resolve(cfs_pick, tasks.size()) == PICK_SCAN;
+    ScanQueue<double> dense(scan ? tasks.size() : 0);
+    auto push = [&](size_t i) {
+        if (scan) dense.push(static_cast<std::uint32_t>(i), tasks.vruntime[i]);
+        else run_queue.push(i);
+    };
+    ArrivalQueue arrivals(tasks.arrival_time);
+    auto admit = [&](size_t i) {
+        if (tasks.remaining_time[i] > 0 && tasks.state[i] == ThreadState::NEW) {
+            tasks.state[i] = ThreadState::READY;
+            push(i);
+        }
+    };
 
     while (remaining > 0) {
-        for (size_t i = 0; i < tasks.size(); ++i) {
-            auto &tk = tasks[i];
-            if (tk->arrival_time <= current_time
-             && tk->remaining_time > 0
-             && tk->state == ThreadState::NEW)
-            {
-                tk->state = ThreadState::READY;
-                run_queue.push(i);
-            }
-        }
+        arrivals.admit_until(current_time, admit);
 
-        if (run_queue.empty()) {
-            ++current_time;
+        if (scan ? dense.empty() : run_queue.empty()) {
+            if (arrivals.empty()) break;
+            // idle: jump straight to the next arrival
+            current_time = arrivals.next_time();
             continue;
         }
 
-        size_t idx = run_queue.top();
-        run_queue.pop();
-        auto &tk = tasks[idx];
+        size_t idx;
+        if (scan) {
+            idx = dense.pop();
+        } else {
+            idx = run_queue.top();
+            run_queue.pop();
+        }
 
-        tk->state = ThreadState::RUNNING;
-        int slice = std::min(tk->remaining_time, time_quantum);
+        tasks.state[idx] = ThreadState::RUNNING;
+        int slice = std::min(tasks.remaining_time[idx], time_quantum);
 
         _timeline.emplace_back(
-            tk->id,
+            tasks.id[idx],
             current_time,
             current_time + slice,
-            tk->state,
-            tk->arrival_time
+            tasks.state[idx],
+            tasks.arrival_time[idx]
         );
 
-        schedule_slice(idx);
+        schedule_slice(idx, slice);
 
-        tk->remaining_time -= slice;
+        tasks.remaining_time[idx] -= slice;
         current_time       += slice;
 
-        double vdelta = slice * (DEFAULT_WEIGHT / tk->weight);
-        tk->vruntime += vdelta;
+        double vdelta = slice * (DEFAULT_WEIGHT / tasks.weight[idx]);
+        tasks.vruntime[idx] += vdelta;
 
-        if (tk->remaining_time <= 0) {
-            tk->state               = ThreadState::FINISHED;
-            g_contexts[idx].finished = true;
+        if (tasks.remaining_time[idx] <= 0) {
+            tasks.state[idx] = ThreadState::FINISHED;
+            retire_context(idx);
             --remaining;
         } else {
-            tk->state = ThreadState::READY;
-            run_queue.push(idx);
+            tasks.state[idx] = ThreadState::READY;
+            push(idx);
         }
     }
 
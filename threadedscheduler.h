@@ -1,12 +1,16 @@
 #ifndef THREADEDSCHEDULER_H
 #define THREADEDSCHEDULER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
 #include <functional>
 #include "ult_context.h"    
 #include "ult_sync.h"      
+#include "pick_kernels.h"
+#include "sched_log.h"
 
 enum ThreadedAlgorithm {
     T_FCFS,
@@ -16,25 +20,55 @@ enum ThreadedAlgorithm {
     T_CFS
 };
 
-enum class ThreadState { NEW, READY, RUNNING, FINISHED };
+enum class ThreadState : std::uint8_t { NEW, READY, RUNNING, FINISHED };
 
-// user‐level thread/task
-struct ThreadedTask {
-    int id;
-    int priority;
-    int arrival_time;
-    int remaining_time;
-    int queue_level;
-    int time_run_in_level;
-    double vruntime;
-    double weight;
-    int nice;
-    ThreadState state;
-  
-    ThreadedTask(int i, int p, int r, int arr)
-        : id(i), priority(p), arrival_time(arr), remaining_time(r),
-          queue_level(0), time_run_in_level(0), vruntime(0.0),
-          weight(1.0), nice(1), state(ThreadState::NEW) {}
+// user-level threads/tasks, one column per field (struct of arrays). A task
+// is addressed by its 32-bit row, so the policies' scans over the ready set
+// read one contiguous column instead of chasing a heap object per task.
+struct ThreadedTaskTable {
+    typedef std::uint32_t Handle;
+
+    std::vector<int> id;
+    std::vector<int> priority;
+    std::vector<int> arrival_time;
+    std::vector<int> remaining_time;
+    std::vector<int> queue_level;
+    std::vector<int> time_run_in_level;
+    std::vector<double> vruntime;
+    std::vector<double> weight;
+    std::vector<int> nice;
+    std::vector<ThreadState> state;
+    std::vector<std::size_t> stack_size;    // ULT stack bytes, 0 = ULT_STACK_SIZE
+
+    std::size_t size() const { return id.size(); }
+    bool empty() const { return id.empty(); }
+
+    Handle add(int i, int p, int r, int arr) {
+        id.push_back(i);
+        priority.push_back(p);
+        arrival_time.push_back(arr);
+        remaining_time.push_back(r);
+        queue_level.push_back(0);
+        time_run_in_level.push_back(0);
+        vruntime.push_back(0.0);
+        weight.push_back(1.0);
+        nice.push_back(1);
+        state.push_back(ThreadState::NEW);
+        stack_size.push_back(0);
+        return static_cast<Handle>(id.size() - 1);
+    }
+
+    void clear() {
+        id.clear(); priority.clear(); arrival_time.clear(); remaining_time.clear();
+        queue_level.clear(); time_run_in_level.clear(); vruntime.clear(); weight.clear();
+        nice.clear(); state.clear(); stack_size.clear();
+    }
+
+    void reserve(std::size_t n) {
+        id.reserve(n); priority.reserve(n); arrival_time.reserve(n); remaining_time.reserve(n);
+        queue_level.reserve(n); time_run_in_level.reserve(n); vruntime.reserve(n); weight.reserve(n);
+        nice.reserve(n); state.reserve(n); stack_size.reserve(n);
+    }
 };
 
 // for recording run timeline
@@ -44,9 +78,10 @@ struct ThreadedTimelineEntry {
     int end_time;
     ThreadState state;
     int arrival_time;
+    int worker;             // M:N worker that ran the slice (0 in single mode)
 
-    ThreadedTimelineEntry(int id_, int s, int e, ThreadState st, int arr)
-        : id(id_), start_time(s), end_time(e), state(st), arrival_time(arr) {}
+    ThreadedTimelineEntry(int id_, int s, int e, ThreadState st, int arr, int w = 0)
+        : id(id_), start_time(s), end_time(e), state(st), arrival_time(arr), worker(w) {}
 };
 
 typedef std::function<void(const std::string&)> Logger;
@@ -58,21 +93,47 @@ public:
     // run chosen scheduling algorithm
     void run();
     const std::vector<ThreadedTimelineEntry>& timeline() const;
-    const std::vector<std::unique_ptr<ThreadedTask>>& get_tasks() const { return tasks; }
+    const ThreadedTaskTable& get_tasks() const { return tasks; }
+    // wall-time budget for a slice of `run` time units, 0 when not preempting
+    long sliceBudgetUs(int run) const {
+        if (preempt_us <= 0 || run <= 0) return 0;
+        long long us = static_cast<long long>(preempt_us) * run / time_quantum;
+        return us > 0 ? static_cast<long>(us) : 1;
+    }
+
+    // binary event from the scheduler thread, formatted later by flushLog()
+    void trace(std::uint16_t kind, int id, int start = 0, int end = 0, int arg = 0);
+    void flushLog();
 
     ThreadedAlgorithm algorithm;
     int time_quantum;
+    int workers;            // > 1 runs the M:N work-stealing runtime
+    int work_ms = 30;       // wall time a ULT spends in each slice (single-worker mode)
+    // > 0: ULTs are CPU hogs that never yield on their own, and a per-worker
+    // timer (ult_preempt.h) takes the CPU back after preempt_us of wall time
+    // per time_quantum of slice; work_ms is then unused. Linux only.
+    int preempt_us = 0;
+    long preempted = 0;     // slices ended by the timer in the last run()
     Logger logger;
-    std::vector<std::unique_ptr<ThreadedTask>> tasks;
+    int log_level = LOG_DEBUG;
+    // ready sets of the single-worker PRIORITY and CFS policies; a CFS scan
+    // breaks vruntime ties by position instead of heap order
+    PickMode priority_pick = PICK_AUTO;
+    PickMode cfs_pick = PICK_QUEUE;
+    EventLog events;
+    ThreadedTaskTable tasks;
     std::vector<ThreadedTimelineEntry> _timeline;
 
 private:
-    void log(const std::string& msg);
+    void log(const std::string& msg, LogLevel level = LOG_INFO);
+    void write(const std::string& msg);
+    void emit(const LogEvent& ev);
     void runFCFS();
     void runRR();
     void runPriority();
     void runMLFQ();
     void runCFS();
+    void runParallel();     // ult_runtime.cpp
 };
 
 #endif // THREADEDSCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,445 @@
+#include "timeline_store.h"
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[4] = { 'T', 'S', 'T', 'L' };
+static const std::uint32_t VERSION = 1;
+static const std::size_t FILE_HEADER = 32;
+static const std::size_t CHUNK_HEADER = 32;
+static const std::uint32_t FLAG_DELTA = 1;
+#if !defined(_WIN32)
+static const std::uint64_t WINDOW = 4 << 20;   // writer mmap window, bytes
+#endif
+
+// all multi-byte fields are little-endian
+static void put_le(unsigned char *p, std::uint64_t v, unsigned width)
+{
+    for (unsigned i = 0; i < width; ++i)
+        p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static std::uint64_t get_le(const unsigned char *p, unsigned width)
+{
+    std::uint64_t v = 0;
+    for (unsigned i = 0; i < width; ++i)
+        v |= std::uint64_t(p[i]) << (8 * i);
+    return v;
+}
+
+static unsigned width_for(std::uint64_t range)
+{
+    return range < (1u << 8) ? 1 : range < (1u << 16) ? 2 : 4;
+}
+
+static void pack_column(unsigned char *&p, const std::vector<std::int64_t> &v,
+                        std::int64_t base, unsigned width)
+{
+    for (std::int64_t x : v)
+    {
+        put_le(p, static_cast<std::uint64_t>(x - base), width);
+        p += width;
+    }
+}
+
+// Chunk header layout (32 bytes):
+//   u32 count | u8 flags | u8 w_id | u8 w_start | u8 w_len
+//   i32 id_base | i32 start0 | i32 gap_base | i32 len_base
+//   u32 payload bytes | u32 reserved
+// Delta columns hold id - id_base, (start[i] - start[i-1]) - gap_base with
+// start[-1] = start0, and (end - start) - len_base. Raw chunks hold id, start
+// and end as int32 and leave the bases zero.
+
+// ---- writer ----------------------------------------------------------------
+
+TimelineWriter::TimelineWriter(bool d, std::uint32_t cr)
+    : delta(d), chunk_records(cr ? cr : 1)
+{
+}
+
+TimelineWriter::~TimelineWriter()
+{
+    close();
+}
+
+bool TimelineWriter::open(const std::string &path)
+{
+    close();
+    failed = false;
+    total = 0;
+    chunks = 0;
+    end_off = FILE_HEADER;
+    ids.reserve(chunk_records);
+    starts.reserve(chunk_records);
+    ends.reserve(chunk_records);
+#if defined(_WIN32)
+    file = std::fopen(path.c_str(), "wb");
+    return file != nullptr;
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    file_size = 0;
+    return fd >= 0;
+#endif
+}
+
+void TimelineWriter::append(int id, int start, int end)
+{
+    ids.push_back(id);
+    starts.push_back(start);
+    ends.push_back(end);
+    if (ids.size() >= chunk_records)
+        flush_chunk();
+}
+
+// copy len bytes to file offset off
+void TimelineWriter::put(std::uint64_t off, const unsigned char *data, std::size_t len)
+{
+#if defined(_WIN32)
+    if (_fseeki64(file, static_cast<__int64>(off), SEEK_SET) != 0 ||
+        std::fwrite(data, 1, len, file) != len)
+        failed = true;
+#else
+    // grow the file a window at a time, then copy through the mapping
+    std::uint64_t need = off + len;
+    if (need > file_size)
+    {
+        std::uint64_t grown = (need + WINDOW - 1) / WINDOW * WINDOW;
+        if (ftruncate(fd, static_cast<off_t>(grown)) != 0)
+        {
+            failed = true;
+            return;
+        }
+        file_size = grown;
+    }
+    while (len > 0)
+    {
+        std::uint64_t base = off / WINDOW * WINDOW;
+        if (!window || window_off != base)
+        {
+            if (window)
+                munmap(window, WINDOW);
+            void *m = mmap(nullptr, WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(base));
+            if (m == MAP_FAILED)
+            {
+                window = nullptr;
+                failed = true;
+                return;
+            }
+            window = static_cast<unsigned char *>(m);
+            window_off = base;
+        }
+        std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(len, base + WINDOW - off));
+        std::memcpy(window + (off - base), data, n);
+        off += n;
+        data += n;
+        len -= n;
+    }
+#endif
+}
+
+void TimelineWriter::flush_chunk()
+{
+    const std::size_t n = ids.size();
+    if (n == 0)
+        return;
+
+    std::vector<std::int64_t> id_col(n), start_col(n), len_col(n);
+    bool use_delta = delta;
+    std::int64_t id_base = 0, start0 = starts[0], gap_base = 0, len_base = 0;
+    unsigned w_id = 4, w_start = 4, w_len = 4;
+
+    if (use_delta)
+    {
+        std::int64_t prev = start0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            id_col[i] = ids[i];
+            start_col[i] = std::int64_t(starts[i]) - prev;
+            len_col[i] = std::int64_t(ends[i]) - starts[i];
+            prev = starts[i];
+        }
+        auto range = [](const std::vector<std::int64_t> &v, std::int64_t &lo) {
+            auto mm = std::minmax_element(v.begin(), v.end());
+            lo = *mm.first;
+            return static_cast<std::uint64_t>(*mm.second - *mm.first);
+        };
+        std::uint64_t r_id = range(id_col, id_base);
+        std::uint64_t r_gap = range(start_col, gap_base);
+        std::uint64_t r_len = range(len_col, len_base);
+        // the bases are stored as int32: fall back to raw if one doesn't fit
+        auto fits = [](std::int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; };
+        if (r_gap > UINT32_MAX || r_len > UINT32_MAX || !fits(gap_base) || !fits(len_base))
+        {
+            use_delta = false;
+        }
+        else
+        {
+            w_id = width_for(r_id);
+            w_start = width_for(r_gap);
+            w_len = width_for(r_len);
+        }
+    }
+    if (!use_delta)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            id_col[i] = static_cast<std::uint32_t>(ids[i]);
+            start_col[i] = static_cast<std::uint32_t>(starts[i]);
+            len_col[i] = static_cast<std::uint32_t>(ends[i]);
+        }
+        id_base = start0 = gap_base = len_base = 0;
+    }
+
+    std::size_t payload = n * (w_id + w_start + w_len);
+    std::size_t bytes = (CHUNK_HEADER + payload + 7) & ~std::size_t(7);
+    enc.assign(bytes, 0);
+    unsigned char *p = enc.data();
+    put_le(p, n, 4);
+    p[4] = static_cast<unsigned char>(use_delta ? FLAG_DELTA : 0);
+    p[5] = static_cast<unsigned char>(w_id);
+    p[6] = static_cast<unsigned char>(w_start);
+    p[7] = static_cast<unsigned char>(w_len);
+    put_le(p + 8, static_cast<std::uint32_t>(id_base), 4);
+    put_le(p + 12, static_cast<std::uint32_t>(start0), 4);
+    put_le(p + 16, static_cast<std::uint32_t>(gap_base), 4);
+    put_le(p + 20, static_cast<std::uint32_t>(len_base), 4);
+    put_le(p + 24, payload, 4);
+
+    unsigned char *q = p + CHUNK_HEADER;
+    pack_column(q, id_col, id_base, w_id);
+    pack_column(q, start_col, gap_base, w_start);
+    pack_column(q, len_col, len_base, w_len);
+
+    put(end_off, enc.data(), bytes);
+    end_off += bytes;
+    total += n;
+    ++chunks;
+    ids.clear();
+    starts.clear();
+    ends.clear();
+}
+
+bool TimelineWriter::close()
+{
+#if defined(_WIN32)
+    if (!file)
+        return !failed;
+#else
+    if (fd < 0)
+        return !failed;
+#endif
+    flush_chunk();
+
+    unsigned char hdr[FILE_HEADER] = {};
+    std::memcpy(hdr, MAGIC, sizeof(MAGIC));
+    put_le(hdr + 4, VERSION, 4);
+    put_le(hdr + 8, delta ? FLAG_DELTA : 0, 4);
+    put_le(hdr + 12, chunk_records, 4);
+    put_le(hdr + 16, total, 8);
+    put_le(hdr + 24, chunks, 4);
+    put(0, hdr, sizeof(hdr));
+
+#if defined(_WIN32)
+    if (std::fclose(file) != 0)
+        failed = true;
+    file = nullptr;
+#else
+    if (window)
+        munmap(window, WINDOW);
+    window = nullptr;
+    // drop the slack left by growing in whole windows
+    if (ftruncate(fd, static_cast<off_t>(end_off)) != 0)
+        failed = true;
+    if (::close(fd) != 0)
+        failed = true;
+    fd = -1;
+#endif
+    return !failed;
+}
+
+// ---- reader ----------------------------------------------------------------
+
+bool TimelineReader::open(const std::string &path)
+{
+    close();
+#if defined(_WIN32)
+    file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        err = "cannot open " + path;
+        return false;
+    }
+    _fseeki64(file, 0, SEEK_END);
+    file_size = static_cast<std::uint64_t>(_ftelli64(file));
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        err = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        file_size = static_cast<std::uint64_t>(st.st_size);
+        void *m = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m != MAP_FAILED)
+        {
+            map = static_cast<const unsigned char *>(m);
+            madvise(m, file_size, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+    if (!map)
+    {
+        err = "cannot map " + path;
+        file_size = 0;
+        return false;
+    }
+#endif
+
+    Chunk whole = { 0, 0, 0 };
+    const unsigned char *hdr = file_size >= FILE_HEADER ? chunk_bytes(whole, FILE_HEADER) : nullptr;
+    if (!hdr || std::memcmp(hdr, MAGIC, sizeof(MAGIC)) != 0 || get_le(hdr + 4, 4) != VERSION)
+    {
+        err = "not a timeline file";
+        close();
+        return false;
+    }
+    std::uint64_t expected = get_le(hdr + 16, 8);
+
+    // index the chunks so read() can seek without decoding
+    std::uint64_t off = FILE_HEADER, first = 0;
+    while (off + CHUNK_HEADER <= file_size)
+    {
+        Chunk ch = { off, first, 0 };
+        const unsigned char *h = chunk_bytes(ch, CHUNK_HEADER);
+        if (!h)
+            break;
+        ch.count = static_cast<std::uint32_t>(get_le(h, 4));
+        std::uint64_t payload = get_le(h + 24, 4);
+        std::uint64_t bytes = (CHUNK_HEADER + payload + 7) & ~std::uint64_t(7);
+        if (ch.count == 0 || off + bytes > file_size)
+            break;
+        index.push_back(ch);
+        first += ch.count;
+        off += bytes;
+    }
+    total = first;
+    if (total != expected)
+        err = "timeline truncated: " + std::to_string(total) + " of " + std::to_string(expected) + " entries";
+    return true;
+}
+
+void TimelineReader::close()
+{
+#if defined(_WIN32)
+    if (file)
+        std::fclose(file);
+    file = nullptr;
+#else
+    if (map)
+        munmap(const_cast<unsigned char *>(map), file_size);
+    map = nullptr;
+#endif
+    index.clear();
+    total = 0;
+    file_size = 0;
+    err.clear();
+}
+
+const unsigned char *TimelineReader::chunk_bytes(const Chunk &ch, std::size_t len) const
+{
+    if (ch.offset + len > file_size)
+        return nullptr;
+#if defined(_WIN32)
+    scratch.resize(len);
+    if (_fseeki64(file, static_cast<__int64>(ch.offset), SEEK_SET) != 0 ||
+        std::fread(scratch.data(), 1, len, file) != len)
+        return nullptr;
+    return scratch.data();
+#else
+    return map + ch.offset;
+#endif
+}
+
+bool TimelineReader::decode_chunk(std::size_t c, std::vector<TimelineEntry> &out) const
+{
+    const Chunk &ch = index[c];
+    const unsigned char *h = chunk_bytes(ch, CHUNK_HEADER);
+    if (!h)
+        return false;
+    bool delta = (h[4] & FLAG_DELTA) != 0;
+    unsigned w_id = h[5], w_start = h[6], w_len = h[7];
+    std::size_t payload = static_cast<std::size_t>(get_le(h + 24, 4));
+    const unsigned char *p = chunk_bytes(ch, CHUNK_HEADER + payload);
+    if (!p)
+        return false;
+
+    std::int32_t id_base = static_cast<std::int32_t>(get_le(p + 8, 4));
+    std::int32_t start0 = static_cast<std::int32_t>(get_le(p + 12, 4));
+    std::int32_t gap_base = static_cast<std::int32_t>(get_le(p + 16, 4));
+    std::int32_t len_base = static_cast<std::int32_t>(get_le(p + 20, 4));
+
+    const std::size_t n = ch.count;
+    const unsigned char *ci = p + CHUNK_HEADER;
+    const unsigned char *cs = ci + n * w_id;
+    const unsigned char *cl = cs + n * w_start;
+    std::size_t at = out.size();
+    out.resize(at + n);
+
+    std::int64_t start = start0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        TimelineEntry &e = out[at + i];
+        std::uint64_t vi = get_le(ci + i * w_id, w_id);
+        std::uint64_t vs = get_le(cs + i * w_start, w_start);
+        std::uint64_t vl = get_le(cl + i * w_len, w_len);
+        if (delta)
+        {
+            start += gap_base + static_cast<std::int64_t>(vs);
+            e.id = static_cast<int>(id_base + static_cast<std::int64_t>(vi));
+            e.start_time = static_cast<int>(start);
+            e.end_time = static_cast<int>(start + len_base + static_cast<std::int64_t>(vl));
+        }
+        else
+        {
+            e.id = static_cast<std::int32_t>(vi);
+            e.start_time = static_cast<std::int32_t>(vs);
+            e.end_time = static_cast<std::int32_t>(vl);
+        }
+    }
+    return true;
+}
+
+std::size_t TimelineReader::read(std::uint64_t first, std::size_t count,
+                                 std::vector<TimelineEntry> &out) const
+{
+    out.clear();
+    if (first >= total || count == 0)
+        return 0;
+
+    // chunk holding `first`
+    auto it = std::upper_bound(index.begin(), index.end(), first,
+                               [](std::uint64_t v, const Chunk &ch) { return v < ch.first; });
+    std::size_t c = static_cast<std::size_t>(it - index.begin()) - 1;
+
+    std::vector<TimelineEntry> buf;
+    std::uint64_t last = std::min<std::uint64_t>(first + count, total);
+    for (; c < index.size() && index[c].first < last; ++c)
+    {
+        buf.clear();
+        if (!decode_chunk(c, buf))
+            break;
+        std::uint64_t lo = std::max(first, index[c].first) - index[c].first;
+        std::uint64_t hi = std::min<std::uint64_t>(last - index[c].first, buf.size());
+        out.insert(out.end(), buf.begin() + lo, buf.begin() + hi);
+    }
+    return out.size();
+}
@@ -0,0 +1,105 @@
+#ifndef TIMELINE_STORE_H
+#define TIMELINE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "scheduler.h"
+
+// On-disk Scheduler timeline.
+// A 32-byte file header is followed by chunks of up to chunk_records entries.
+// A chunk stores its entries column by column (ids, start times, lengths),
+// each column at one fixed width (1, 2 or 4 bytes) chosen per chunk. With
+// delta encoding, ids and lengths are stored as offsets from the chunk
+// minimum and start times as gaps from the previous entry, so a typical
+// chunk needs 1-2 bytes per field; without it every field is a raw int32.
+// On POSIX the writer appends through a sliding mmap window and the reader
+// maps the whole file; elsewhere both fall back to stdio.
+
+class TimelineWriter {
+public:
+    explicit TimelineWriter(bool delta = true, std::uint32_t chunk_records = 65536);
+    ~TimelineWriter();
+
+    bool open(const std::string &path);
+    void append(int id, int start, int end);
+    bool close();   // flushes and writes the header; false if any write failed
+
+    std::uint64_t size() const { return total; }
+
+private:
+    void flush_chunk();
+    void put(std::uint64_t off, const unsigned char *data, std::size_t len);
+
+    bool delta;
+    std::uint32_t chunk_records;
+    std::vector<std::int32_t> ids, starts, ends;
+    std::vector<unsigned char> enc;
+    std::uint64_t total = 0;
+    std::uint32_t chunks = 0;
+    std::uint64_t end_off = 0;   // where the next chunk goes
+    bool failed = false;
+
+#if defined(_WIN32)
+    std::FILE *file = nullptr;
+#else
+    int fd = -1;
+    std::uint64_t file_size = 0;
+    unsigned char *window = nullptr;
+    std::uint64_t window_off = 0;
+#endif
+};
+
+class TimelineReader {
+public:
+    TimelineReader() {}
+    ~TimelineReader() { close(); }
+    TimelineReader(const TimelineReader &) = delete;
+    TimelineReader &operator=(const TimelineReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    std::uint64_t size() const { return total; }
+    const std::string &error() const { return err; }
+
+    // decode entries [first, first + count) into out; returns how many
+    std::size_t read(std::uint64_t first, std::size_t count, std::vector<TimelineEntry> &out) const;
+
+    // call f(const TimelineEntry&) for every entry, one chunk in memory at a time
+    template <typename F>
+    void for_each(F f) const {
+        std::vector<TimelineEntry> buf;
+        for (std::size_t c = 0; c < index.size(); ++c) {
+            buf.clear();
+            decode_chunk(c, buf);
+            for (const auto &e : buf) f(e);
+        }
+    }
+
+private:
+    struct Chunk {
+        std::uint64_t offset;   // of the chunk header
+        std::uint64_t first;    // index of its first entry
+        std::uint32_t count;
+    };
+
+    bool decode_chunk(std::size_t c, std::vector<TimelineEntry> &out) const;
+    const unsigned char *chunk_bytes(const Chunk &ch, std::size_t len) const;
+
+    std::vector<Chunk> index;
+    std::uint64_t total = 0;
+    std::uint64_t file_size = 0;
+    std::string err;
+
+#if defined(_WIN32)
+    std::FILE *file = nullptr;
+    mutable std::vector<unsigned char> scratch;
+#else
+    const unsigned char *map = nullptr;
+#endif
+};
+
+#endif // TIMELINE_STORE_H
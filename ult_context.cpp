@@ -0,0 +1,372 @@
+#include "ult_context.h"
+#include "ult_stack.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#if defined(ULT_BACKEND_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(ULT_BACKEND_UCONTEXT)
+#include <ucontext.h>
+#endif
+
+// one record per fiber, including the converted OS thread (which has no stack)
+struct ULTFiberImpl {
+    void*       sp;          // saved stack pointer (asm backend)
+    ULTStack    stack;       // pooled stack, {nullptr, 0} for a converted thread
+    ULTEntry    fn;
+    void*       arg;
+    // no-preemption depth; written only by the fiber itself, read by the
+    // timer's signal handler on the same thread. A new fiber starts at 1 and
+    // drops to 0 once it runs; a converted thread stays at 1.
+    std::atomic<int> nopreempt{1};
+    std::atomic<unsigned long> resumes{0};    // times switched back in
+#if defined(ULT_BACKEND_WIN32)
+    LPVOID      handle;      // the real Win32 fiber
+#elif defined(ULT_BACKEND_UCONTEXT)
+    ucontext_t  uc;
+#endif
+};
+
+[[noreturn]] static void ult_fatal(const char* msg)
+{
+    std::fprintf(stderr, "[ULT] fatal: %s\n", msg);
+    std::abort();
+}
+
+// a fiber body returning would leave nothing to resume, same rule as Win32
+extern "C" [[noreturn]] void ult_fiber_main(ULTFiberImpl* f)
+{
+    f->nopreempt.store(0, std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    f->fn(f->arg);
+    ult_fatal("fiber body returned");
+}
+
+#if defined(ULT_BACKEND_WIN32)
+
+static void WINAPI ult_win32_entry(LPVOID p)
+{
+    ult_fiber_main(static_cast<ULTFiberImpl*>(p));
+}
+
+#else
+
+static thread_local ULTFiberImpl* tls_current = nullptr;
+
+// only the fiber itself changes its depth, so a plain load and store will
+// do; the signal fences keep the compiler from moving code across them
+static void nopreempt_up(ULTFiberImpl* f)
+{
+    f->nopreempt.store(f->nopreempt.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+static int nopreempt_down(ULTFiberImpl* f)
+{
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    int depth = f->nopreempt.load(std::memory_order_relaxed) - 1;
+    f->nopreempt.store(depth, std::memory_order_relaxed);
+    return depth;
+}
+
+#endif
+
+#if defined(ULT_BACKEND_ASM)
+
+// void ult_asm_switch(void** save_sp, void* load_sp)
+// Pushes the callee-saved registers on the current stack, stores sp into
+// *save_sp, loads load_sp and pops the other fiber's registers. A new fiber's
+// stack is pre-seeded so the final `ret` lands in ult_asm_entry, which calls
+// ult_fiber_main(fiber) with the pointer that was parked in a callee-saved reg.
+extern "C" void ult_asm_switch(void** save_sp, void* load_sp);
+extern "C" void ult_asm_entry();
+
+#if defined(__x86_64__)
+__asm__(
+    ".text\n"
+    ".globl ult_asm_switch\n"
+    ".hidden ult_asm_switch\n"
+    ".type ult_asm_switch,%function\n"
+    "ult_asm_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size ult_asm_switch,.-ult_asm_switch\n"
+    ".globl ult_asm_entry\n"
+    ".hidden ult_asm_entry\n"
+    ".type ult_asm_entry,%function\n"
+    "ult_asm_entry:\n"
+    "    movq %r12, %rdi\n"
+    "    andq $-16, %rsp\n"
+    "    callq *%r13\n"
+    "    ud2\n"
+    ".size ult_asm_entry,.-ult_asm_entry\n");
+
+static void ult_seed_stack(ULTFiberImpl* f)
+{
+    std::uintptr_t top = reinterpret_cast<std::uintptr_t>(f->stack.base + f->stack.size);
+    void** sp = reinterpret_cast<void**>(top & ~std::uintptr_t(15));
+    *--sp = nullptr;                                           // alignment pad
+    *--sp = reinterpret_cast<void*>(&ult_asm_entry);           // ret target
+    *--sp = nullptr;                                           // rbp
+    *--sp = nullptr;                                           // rbx
+    *--sp = f;                                                 // r12
+    *--sp = reinterpret_cast<void*>(&ult_fiber_main);          // r13
+    *--sp = nullptr;                                           // r14
+    *--sp = nullptr;                                           // r15
+    // default MXCSR (0x1F80) and x87 control word (0x037F)
+    *--sp = reinterpret_cast<void*>(std::uintptr_t(0x1F80) | (std::uintptr_t(0x037F) << 32));
+    f->sp = sp;
+}
+
+#elif defined(__aarch64__)
+__asm__(
+    ".text\n"
+    ".globl ult_asm_switch\n"
+    ".hidden ult_asm_switch\n"
+    ".type ult_asm_switch,%function\n"
+    "ult_asm_switch:\n"
+    "    sub sp, sp, #0xa0\n"
+    "    stp x19, x20, [sp, #0x00]\n"
+    "    stp x21, x22, [sp, #0x10]\n"
+    "    stp x23, x24, [sp, #0x20]\n"
+    "    stp x25, x26, [sp, #0x30]\n"
+    "    stp x27, x28, [sp, #0x40]\n"
+    "    stp x29, x30, [sp, #0x50]\n"
+    "    stp d8,  d9,  [sp, #0x60]\n"
+    "    stp d10, d11, [sp, #0x70]\n"
+    "    stp d12, d13, [sp, #0x80]\n"
+    "    stp d14, d15, [sp, #0x90]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0x00]\n"
+    "    ldp x21, x22, [sp, #0x10]\n"
+    "    ldp x23, x24, [sp, #0x20]\n"
+    "    ldp x25, x26, [sp, #0x30]\n"
+    "    ldp x27, x28, [sp, #0x40]\n"
+    "    ldp x29, x30, [sp, #0x50]\n"
+    "    ldp d8,  d9,  [sp, #0x60]\n"
+    "    ldp d10, d11, [sp, #0x70]\n"
+    "    ldp d12, d13, [sp, #0x80]\n"
+    "    ldp d14, d15, [sp, #0x90]\n"
+    "    add sp, sp, #0xa0\n"
+    "    ret\n"
+    ".size ult_asm_switch,.-ult_asm_switch\n"
+    ".globl ult_asm_entry\n"
+    ".hidden ult_asm_entry\n"
+    ".type ult_asm_entry,%function\n"
+    "ult_asm_entry:\n"
+    "    mov x0, x19\n"
+    "    blr x20\n"
+    "    brk #0\n"
+    ".size ult_asm_entry,.-ult_asm_entry\n");
+
+static void ult_seed_stack(ULTFiberImpl* f)
+{
+    std::uintptr_t top = reinterpret_cast<std::uintptr_t>(f->stack.base + f->stack.size);
+    void** sp = reinterpret_cast<void**>((top & ~std::uintptr_t(15)) - 0xa0);
+    for (int i = 0; i < 20; ++i)
+        sp[i] = nullptr;
+    sp[0]  = f;                                                // x19
+    sp[1]  = reinterpret_cast<void*>(&ult_fiber_main);         // x20
+    sp[11] = reinterpret_cast<void*>(&ult_asm_entry);          // x30 (lr)
+    f->sp = sp;
+}
+#endif
+
+#elif defined(ULT_BACKEND_UCONTEXT)
+
+// makecontext only passes ints, so the new fiber finds itself via tls_current
+static void ult_ucontext_entry()
+{
+    ult_fiber_main(tls_current);
+}
+
+#endif
+
+ULTFiber ult_convert_thread()
+{
+#if defined(ULT_BACKEND_WIN32)
+    ULTFiberImpl* f = new ULTFiberImpl();
+    f->handle = ConvertThreadToFiber(f);
+    if (!f->handle) {
+        delete f;
+        return nullptr;
+    }
+    return f;
+#else
+    if (tls_current)
+        return tls_current;
+    tls_current = new ULTFiberImpl();
+    return tls_current;
+#endif
+}
+
+void ult_convert_back()
+{
+#if defined(ULT_BACKEND_WIN32)
+    ULTFiberImpl* f = static_cast<ULTFiberImpl*>(GetFiberData());
+    ConvertFiberToThread();
+    delete f;
+#else
+    if (tls_current && !tls_current->stack.base) {
+        delete tls_current;
+        tls_current = nullptr;
+    }
+#endif
+}
+
+ULTFiber ult_create_fiber(std::size_t stack_size, ULTEntry fn, void* arg)
+{
+    ULTFiberImpl* f = new ULTFiberImpl();
+    f->fn = fn;
+    f->arg = arg;
+    if (!stack_size)
+        stack_size = ULT_STACK_SIZE;
+
+#if defined(ULT_BACKEND_WIN32)
+    // reserve the full size but commit a single page; Windows grows the
+    // committed region on demand behind its own guard page
+    f->handle = CreateFiberEx(4096, stack_size, 0, ult_win32_entry, f);
+    if (!f->handle) {
+        delete f;
+        return nullptr;
+    }
+#else
+    f->stack = ult_stack_acquire(stack_size);
+    if (!f->stack.base) {
+        delete f;
+        return nullptr;
+    }
+#if defined(ULT_BACKEND_ASM)
+    ult_seed_stack(f);
+#else
+    getcontext(&f->uc);
+    f->uc.uc_stack.ss_sp = f->stack.base;
+    f->uc.uc_stack.ss_size = f->stack.size;
+    f->uc.uc_link = nullptr;
+    makecontext(&f->uc, ult_ucontext_entry, 0);
+#endif
+#endif
+    return f;
+}
+
+void ult_delete_fiber(ULTFiber fiber)
+{
+    ULTFiberImpl* f = static_cast<ULTFiberImpl*>(fiber);
+    if (!f)
+        return;
+#if defined(ULT_BACKEND_WIN32)
+    DeleteFiber(f->handle);
+#else
+    if (f == tls_current)
+        ult_fatal("deleting the running fiber");
+    ult_stack_release(f->stack);
+#endif
+    delete f;
+}
+
+void ult_switch_to(ULTFiber to)
+{
+    ULTFiberImpl* next = static_cast<ULTFiberImpl*>(to);
+#if defined(ULT_BACKEND_WIN32)
+    SwitchToFiber(next->handle);
+#else
+    ULTFiberImpl* from = tls_current;
+    if (!from)
+        ult_fatal("ult_switch_to called before ult_convert_thread");
+    if (from == next)
+        return;
+    // neither fiber may be switched out by the timer halfway through this
+    nopreempt_up(from);
+    tls_current = next;
+#if defined(ULT_BACKEND_ASM)
+    ult_asm_switch(&from->sp, next->sp);
+#else
+    swapcontext(&from->uc, &next->uc);
+#endif
+    // `from` runs again, maybe on another OS thread, so no thread-local
+    // read before the switch may be reused here
+    from->resumes.store(from->resumes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    nopreempt_down(from);
+#endif
+}
+
+ULTFiber ult_current()
+{
+#if defined(ULT_BACKEND_WIN32)
+    return GetFiberData();
+#else
+    return tls_current;
+#endif
+}
+
+unsigned long ult_resumes(ULTFiber fiber)
+{
+    return static_cast<ULTFiberImpl*>(fiber)->resumes.load(std::memory_order_relaxed);
+}
+
+void ult_yield()
+{
+#if defined(ULT_BACKEND_WIN32)
+    ult_switch_to(scheduler_fiber);
+#else
+    // scheduler_fiber is this thread's only until the timer switches us out
+    ULTFiberImpl* self = tls_current;
+    nopreempt_up(self);
+    ult_switch_to(scheduler_fiber);
+    nopreempt_down(self);
+#endif
+}
+
+void ult_nopreempt_enter()
+{
+#if !defined(ULT_BACKEND_WIN32)
+    if (tls_current)
+        nopreempt_up(tls_current);
+#endif
+}
+
+bool ult_nopreempt_leave()
+{
+#if !defined(ULT_BACKEND_WIN32)
+    return tls_current && nopreempt_down(tls_current) == 0;
+#else
+    return false;
+#endif
+}
+
+bool ult_preemptible()
+{
+#if !defined(ULT_BACKEND_WIN32)
+    ULTFiberImpl* f = tls_current;
+    return f && f->nopreempt.load(std::memory_order_relaxed) == 0;
+#else
+    return false;
+#endif
+}
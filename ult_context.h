@@ -1,17 +1,82 @@
 #pragma once
-#include <windows.h>
+#include <atomic>
 #include <vector>
 #include <deque>
 #include <cstddef>
+#include <cstdint>
+
+// Context-switch backend for the user-level threads.
+//   Win32           : CreateFiber / SwitchToFiber
+//   Linux x86-64/A64: hand-written register switch (ult_context.cpp)
+//   anything else   : <ucontext.h> swapcontext
+// Define ULT_FORCE_UCONTEXT to use the ucontext path on Linux as well.
+#if defined(_WIN32)
+#define ULT_BACKEND_WIN32 1
+#elif defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__)) && !defined(ULT_FORCE_UCONTEXT)
+#define ULT_BACKEND_ASM 1
+#else
+#define ULT_BACKEND_UCONTEXT 1
+#endif
 
 static const std::size_t ULT_STACK_SIZE = 64 * 1024;
 
+typedef void* ULTFiber;                 // opaque fiber handle (LPVOID on Win32)
+typedef void (*ULTEntry)(void* arg);    // fiber body, must never return
+
+// turn the calling OS thread into a fiber so it can switch to ULTs
+ULTFiber ult_convert_thread();
+void     ult_convert_back();
+
+// create / destroy a ULT running fn(arg) on its own stack
+ULTFiber ult_create_fiber(std::size_t stack_size, ULTEntry fn, void* arg);
+void     ult_delete_fiber(ULTFiber fiber);
+
+// save the running fiber and resume `to` (same contract as SwitchToFiber)
+void     ult_switch_to(ULTFiber to);
+
+// called from a ULT: switch back to the scheduler fiber of whichever OS thread
+// is running it right now. ULTs may migrate between workers in M:N mode, so
+// ULT code must use this rather than caching scheduler_fiber across a switch.
+void     ult_yield();
+
+// the running fiber, and how many times a fiber has been switched back in;
+// a ULT compares counts to tell whether it was switched out in between
+ULTFiber      ult_current();
+unsigned long ult_resumes(ULTFiber fiber);
+
+// No-preemption depth of the running fiber. The preemption timer
+// (ult_preempt.h) switches a fiber out from its signal handler only while
+// this is zero. A fiber holds it up across every switch until it runs
+// again, and a converted OS thread never drops to zero. Use
+// ult_preempt_disable()/ult_preempt_enable() rather than these.
+void     ult_nopreempt_enter();
+bool     ult_nopreempt_leave();     // true once back at zero
+bool     ult_preemptible();         // async-signal-safe
+
 struct ULTContext {
-  LPVOID fiber;     // the fiber handle
-  bool   finished;  // ULT exited?
+  ULTFiber fiber = nullptr;     // the fiber handle
+  bool     finished = false;    // ULT exited?
+  std::atomic<int> park{0};     // ULTParkState (ult_sync.h)
+  std::size_t next = SIZE_MAX;  // link on a wait list, then on a wake inbox
+  int      worker = 0;          // worker that last ran it; wakeups go there
+  std::atomic<const void*> blocked_on{nullptr};  // ULTMutex it is parked on
+  void*    revoked = nullptr;   // mutexes deadlock recovery took from it
+
+  ULTContext() {}
+  // copied only while no ULT runs (vector growth)
+  ULTContext(const ULTContext& o)
+    : fiber(o.fiber), finished(o.finished), park(o.park.load()), next(o.next), worker(o.worker),
+      blocked_on(o.blocked_on.load()), revoked(o.revoked) {}
+  ULTContext& operator=(const ULTContext& o) {
+    fiber = o.fiber; finished = o.finished; park.store(o.park.load());
+    next = o.next; worker = o.worker;
+    blocked_on.store(o.blocked_on.load()); revoked = o.revoked;
+    return *this;
+  }
 };
 
-extern LPVOID                scheduler_fiber;   
+// scheduler_fiber and g_current_idx are per OS thread: one per M:N worker
+extern thread_local ULTFiber    scheduler_fiber;
 extern std::vector<ULTContext> g_contexts;      // all ULTs
-extern std::size_t           g_current_idx;     // which ULT is running
+extern thread_local std::size_t g_current_idx;  // which ULT is running
 extern std::deque<std::size_t> ready_queue;     // ready list for scheuler
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev work-stealing deque (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models", PPoPP'13).
+// The owning worker pushes and pops at the bottom (LIFO); any other worker
+// may steal from the top (FIFO). T must be trivially copyable.
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(std::size_t capacity = 256)
+        : top(0), bottom(0)
+    {
+        std::size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        buffers.emplace_back(new Buffer(cap));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // owner only
+    void push(T item)
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(a->mask)) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only
+    bool pop(T& out)
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        out = a->get(b);
+        if (t == b) {
+            // last element: race against thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1,
+                                                   std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread
+    bool steal(T& out)
+    {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        Buffer* a = buffer.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+            return false;
+        out = item;
+        return true;
+    }
+
+    // racy, only meant for load-balancing heuristics
+    std::size_t size_estimate() const
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<std::size_t>(b - t) : 0;
+    }
+
+private:
+    struct Buffer {
+        std::size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Buffer(std::size_t cap) : mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+        T get(std::int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T v) { slots[i & mask].store(v, std::memory_order_relaxed); }
+    };
+
+    Buffer* grow(Buffer* a, std::int64_t t, std::int64_t b)
+    {
+        // old buffers stay alive until the deque dies: a thief may still be
+        // reading from one, and growth is rare enough not to matter
+        buffers.emplace_back(new Buffer((a->mask + 1) * 2));
+        Buffer* na = buffers.back().get();
+        for (std::int64_t i = t; i < b; ++i)
+            na->put(i, a->get(i));
+        buffer.store(na, std::memory_order_release);
+        return na;
+    }
+
+    alignas(64) std::atomic<std::int64_t> top;
+    alignas(64) std::atomic<std::int64_t> bottom;
+    std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers;   // owner only
+};
@@ -0,0 +1,199 @@
+#include "ult_preempt.h"
+#include "ult_context.h"
+#include <csignal>
+#include <mutex>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// SIGURG is ignored by default and rarely used by anything else, so a late
+// tick after a timer is gone cannot kill the process
+static const int PREEMPT_SIGNAL = SIGURG;
+
+static thread_local volatile std::sig_atomic_t t_pending = 0;
+static thread_local long t_ticks = 0;
+static thread_local timer_t t_timer;
+static thread_local bool t_has_timer = false;
+static thread_local bool t_armed = false;
+
+// what handled PREEMPT_SIGNAL before us; signals that are not our ticks
+// go there
+static struct sigaction g_prev_action;
+// sigev_value of our timers, to tell their ticks apart
+static char g_tick_tag;
+
+// Read afresh on every call, never from a value or address the compiler
+// kept from before a switch: the ULT may have been resumed on another
+// worker since. The asm keeps GCC from treating them as const functions,
+// which __errno_location is declared to be.
+static __attribute__((noinline)) int* errno_here() {
+    int* p = &errno;
+    __asm__ volatile("" : "+r"(p));
+    return p;
+}
+
+static __attribute__((noinline)) bool armed_here() {
+    bool armed = t_armed;
+    __asm__ volatile("" : "+r"(armed));
+    return armed;
+}
+
+static void chain(int sig, siginfo_t* si, void* uc) {
+    if (g_prev_action.sa_flags & SA_SIGINFO) {
+        if (g_prev_action.sa_sigaction) g_prev_action.sa_sigaction(sig, si, uc);
+    } else if (g_prev_action.sa_handler != SIG_DFL && g_prev_action.sa_handler != SIG_IGN) {
+        g_prev_action.sa_handler(sig);
+    }
+}
+
+static void on_tick(int sig, siginfo_t* si, void* uc) {
+    if (si->si_code != SI_TIMER || si->si_value.sival_ptr != &g_tick_tag) {
+        chain(sig, si, uc);
+        return;
+    }
+    t_pending = 1;
+    ++t_ticks;
+    if (!ult_preemptible()) return;     // deferred to the end of the section
+
+    // Switch out from inside the handler. The scheduler must take ticks
+    // meanwhile, so unblock ours first; the kernel restores the ULT's own
+    // mask when the handler returns on its next dispatch. Nothing
+    // thread-local may be touched after the switch through anything worked
+    // out before it: that may be another worker. errno is the resumed
+    // thread's own, so it is looked up again.
+    int saved_errno = *errno_here();
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, PREEMPT_SIGNAL);
+    pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+    ult_yield();
+    *errno_here() = saved_errno;
+}
+
+static void install_handler() {
+    struct sigaction sa = {};
+    sa.sa_sigaction = on_tick;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(PREEMPT_SIGNAL, &sa, &g_prev_action);
+}
+
+static void set_timer(long usec) {
+    struct itimerspec its = {};
+    its.it_value.tv_sec = usec / 1000000;
+    its.it_value.tv_nsec = (usec % 1000000) * 1000;
+    timer_settime(t_timer, 0, &its, nullptr);
+}
+
+bool ult_preempt_supported() {
+    return true;
+}
+
+bool ult_preempt_thread_init() {
+    static std::once_flag once;
+    std::call_once(once, install_handler);
+    if (t_has_timer) return true;
+
+    // touch the handler's thread-locals first, so a lazily allocated TLS
+    // block (shared-library builds) is never set up from inside the handler
+    t_pending = 0;
+    t_ticks = 0;
+
+    struct sigevent sev = {};
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = PREEMPT_SIGNAL;
+    sev.sigev_value.sival_ptr = &g_tick_tag;
+    sev.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+    if (timer_create(CLOCK_MONOTONIC, &sev, &t_timer) != 0) return false;
+    t_has_timer = true;
+    return true;
+}
+
+void ult_preempt_thread_exit() {
+    if (!t_has_timer) return;
+    timer_delete(t_timer);
+    t_has_timer = false;
+    t_armed = false;
+    t_pending = 0;
+}
+
+void ult_preempt_arm(long usec) {
+    if (!t_has_timer) return;
+    t_pending = 0;
+    t_armed = true;
+    set_timer(usec > 0 ? usec : 1);
+}
+
+void ult_preempt_disarm() {
+    if (!t_has_timer) return;
+    set_timer(0);
+    t_armed = false;
+    // a tick generated before the timer stopped is delivered on return from
+    // timer_settime, so clearing now cannot leave a stale flag behind
+    t_pending = 0;
+}
+
+bool ult_preempt_armed() {
+    return armed_here();
+}
+
+bool ult_preempt_pending() {
+    return t_pending != 0;
+}
+
+long ult_preempt_ticks() {
+    return t_ticks;
+}
+
+#else
+
+bool ult_preempt_supported() { return false; }
+bool ult_preempt_thread_init() { return false; }
+void ult_preempt_thread_exit() {}
+void ult_preempt_arm(long) {}
+void ult_preempt_disarm() {}
+bool ult_preempt_armed() { return false; }
+static bool armed_here() { return false; }
+bool ult_preempt_pending() { return false; }
+long ult_preempt_ticks() { return 0; }
+
+#endif
+
+void ult_preempt_disable() {
+    ult_nopreempt_enter();
+}
+
+void ult_preempt_enable() {
+    if (ult_nopreempt_leave() && ult_preempt_pending()) ult_yield();
+}
+
+bool ult_safepoint() {
+    if (!ult_preempt_pending() || !ult_preemptible()) return false;
+    ult_yield();
+    return true;
+}
+
+bool ult_spin_until_tick() {
+    // The tick switches us out from its handler, or at the safepoint if it
+    // was deferred. We may come back on another worker, so what tells us
+    // is our own fiber, not this thread's timer state. Count the resumes
+    // before looking at the timer: a tick in between must not leave us
+    // waiting for another one on a worker that resumed us without a timer.
+    ULTFiber self = ult_current();
+    const unsigned long resumes = ult_resumes(self);
+    volatile unsigned sink = 0;
+    while (ult_resumes(self) == resumes) {
+        if (!armed_here()) return false;
+        for (unsigned i = 0; i < 1024; ++i) sink += i;
+        ult_safepoint();
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Timer-driven ULT preemption.
+// On Linux every worker thread owns a POSIX timer (timer_create with
+// SIGEV_THREAD_ID) that signals that thread alone. The handler raises a
+// per-thread flag and, if the running ULT may be preempted, switches it
+// back to the scheduler right there; it resumes inside the handler on its
+// next dispatch, on whichever worker. A ULT is not preemptible while it is
+// in a no-preemption section: between ult_preempt_disable() and
+// ult_preempt_enable(), while it holds a ULTMutex, a ULTRWLock or a
+// ULTSpinLock, or inside the runtime's own switch and park code. A tick
+// that fires in one is deferred: the ULT yields as the outermost section
+// ends, or at an ult_safepoint(). Sections are counted per ULT, so they
+// follow it across a park or a migration.
+//
+// The switch can come between any two instructions, so ULT code that runs
+// under the timer must put anything that is not async-signal-safe (malloc,
+// stdio, std::mutex, ...) in a section of its own; a ULT stopped inside
+// malloc would deadlock its worker. Other handlers of the timer signal
+// still get the signals that are not ticks. On other platforms the timer
+// calls do nothing and ticks never fire.
+
+bool ult_preempt_supported();
+bool ult_preempt_thread_init();     // create the calling thread's timer
+void ult_preempt_thread_exit();
+
+void ult_preempt_arm(long usec);    // one-shot tick after usec of wall time
+void ult_preempt_disarm();          // cancel the tick and clear the flag
+bool ult_preempt_armed();           // is a tick outstanding for this slice?
+bool ult_preempt_pending();         // has this thread's tick fired?
+long ult_preempt_ticks();           // ticks this thread has received
+
+// no-preemption section for ULT code; nestable
+void ult_preempt_disable();
+void ult_preempt_enable();          // takes a tick deferred meanwhile
+
+// safepoint for ULT code: yield to the scheduler if the tick has fired
+// (outside any no-preemption section)
+bool ult_safepoint();
+
+// a compute-bound ULT body: burn CPU until the tick has taken the CPU back
+// once, and return in the slice after. False when no tick is armed, at
+// once or once a worker has resumed it without one.
+bool ult_spin_until_tick();
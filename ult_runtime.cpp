@@ -0,0 +1,488 @@
+// M:N user-level thread runtime: `workers` OS threads, each with its own
+// scheduler fiber, a Chase-Lev deque of ULT indices that other workers can
+// steal from, and a small local run queue ordered by the active policy.
+// A worker with nothing to run or steal spins briefly, then sleeps until a
+// ULT is woken onto it or another worker publishes some to steal.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "ult_context.h"
+#include "ult_deque.h"
+#include "ult_preempt.h"
+#include "ult_sync.h"
+#include "threadedscheduler.h"
+
+// how many ULTs a worker moves from its deque into the local policy at once;
+// anything beyond this window stays in the deque where thieves can see it
+static const std::size_t LOCAL_WINDOW = 8;
+static const int MLFQ_LEVELS = 3;
+static const double CFS_DEFAULT_WEIGHT = 1024.0;
+// rounds an idle worker yields and looks for work before it goes to sleep
+static const int IDLE_SPINS = 64;
+
+namespace {
+
+// per-worker ready queue, ordered by the scheduler's policy.
+// The window is small, so PRIORITY and CFS just scan it.
+class LocalPolicy {
+public:
+    LocalPolicy(ThreadedAlgorithm a, const ThreadedTaskTable& t)
+        : algo(a), tasks(t) {}
+
+    bool empty() const { return size() == 0; }
+
+    std::size_t size() const {
+        std::size_t n = 0;
+        for (auto& q : levels) n += q.size();
+        return n;
+    }
+
+    void push(std::size_t idx) {
+        int lvl = (algo == T_MLFQ) ? tasks.queue_level[idx] : 0;
+        levels[lvl].push_back(idx);
+    }
+
+    std::size_t pick() {
+        if (algo == T_MLFQ) {
+            for (auto& q : levels) {
+                if (!q.empty()) {
+                    std::size_t idx = q.front(); q.pop_front();
+                    return idx;
+                }
+            }
+        }
+
+        auto& q = levels[0];
+        auto best = q.begin();
+        if (algo == T_PRIORITY) {
+            for (auto it = q.begin(); it != q.end(); ++it)
+                if (tasks.priority[*it] > tasks.priority[*best]) best = it;
+        } else if (algo == T_CFS) {
+            for (auto it = q.begin(); it != q.end(); ++it)
+                if (tasks.vruntime[*it] < tasks.vruntime[*best]) best = it;
+        }
+        std::size_t idx = *best;
+        q.erase(best);
+        return idx;
+    }
+
+    // give up the least urgent ULT so it can be published for stealing
+    bool spill(std::size_t& idx) {
+        for (int l = MLFQ_LEVELS - 1; l >= 0; --l) {
+            if (!levels[l].empty()) {
+                idx = levels[l].back(); levels[l].pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    ThreadedAlgorithm algo;
+    const ThreadedTaskTable& tasks;
+    std::deque<std::size_t> levels[MLFQ_LEVELS];
+};
+
+// One-permit sleep/wake for an idle worker, the same protocol as
+// SchedulerEngine's Parker (cpp_scheduler/scheduler.cpp): unpark() leaves a
+// permit that the next park() consumes, so a wake-up sent while the worker
+// is still on its way to sleep is not lost, and only a worker that really
+// sleeps costs a system call.
+class Parker {
+public:
+    void park() {
+        // NOTIFIED -> EMPTY returns at once; EMPTY -> PARKED sleeps
+        if (state.fetch_sub(1, std::memory_order_acquire) == NOTIFIED) return;
+        for (;;) {
+            sleep();
+            int expected = NOTIFIED;
+            if (state.compare_exchange_strong(expected, EMPTY, std::memory_order_acquire)) return;
+        }
+    }
+
+    void unpark() {
+        if (state.exchange(NOTIFIED, std::memory_order_release) == PARKED) wake();
+    }
+
+private:
+    static const int PARKED = -1, EMPTY = 0, NOTIFIED = 1;
+    std::atomic<int> state{EMPTY};
+
+#if defined(__linux__)
+    void sleep() {
+        syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAIT_PRIVATE, PARKED, nullptr, nullptr, 0);
+    }
+    void wake() {
+        syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+#else
+    std::mutex m;
+    std::condition_variable cv;
+    void sleep() {
+        std::unique_lock<std::mutex> lock(m);
+        while (state.load(std::memory_order_relaxed) == PARKED) cv.wait(lock);
+    }
+    void wake() {
+        { std::lock_guard<std::mutex> lock(m); }
+        cv.notify_one();
+    }
+#endif
+};
+
+struct Worker {
+    int id = 0;
+    WorkStealingDeque<std::size_t> deque;
+    std::vector<ThreadedTimelineEntry> timeline;
+    int clock = 0;          // this worker's simulated time
+    long slices = 0;
+    long steals = 0;
+    long preempted = 0;     // slices ended by this worker's timer
+    long parks = 0;         // slices that ended with the ULT parked
+    long handoffs = 0;      // ULTs run next because a lock was handed to them
+    // ULTs parked here and since woken, pushed by any thread; a Treiber
+    // stack linked through ULTContext::next
+    std::atomic<std::size_t> inbox{ULT_NIL};
+    EventLog events;        // per-slice trace, drained by the runParallel thread
+    // out of work: spinning, or asleep on `parker` until a ULT is woken
+    // onto its inbox, another worker publishes ULTs to steal, or the run ends
+    std::atomic<bool> idle{false};
+    Parker parker;
+};
+
+struct MNState {
+    ThreadedScheduler* sched;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> remaining{0};
+    std::atomic<int> idle{0};
+};
+
+} // namespace
+
+static MNState* g_mn = nullptr;
+
+// every M:N slice bumps one counter under one ULTMutex, so the workers'
+// ULTs really contend for it
+static ULTMutex g_mn_mtx;
+static long g_mn_counter = 0;
+
+// ult_unpark() target: hand the ULT back to the worker it parked on
+static void mn_wake(std::size_t idx) {
+    Worker& w = *g_mn->workers[g_contexts[idx].worker];
+    std::size_t head = w.inbox.load(std::memory_order_relaxed);
+    do {
+        g_contexts[idx].next = head;
+    } while (!w.inbox.compare_exchange_weak(head, idx, std::memory_order_release, std::memory_order_relaxed));
+    w.parker.unpark();
+}
+
+// after publishing ULTs for stealing: wake the workers that have none. An
+// idle worker raises its flag before it looks for work one last time, so
+// with a fence on each side either it sees our ULTs or we see the flag.
+static void wake_idle(MNState& st, Worker& self) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto& w : st.workers)
+        if (w.get() != &self && w->idle.load(std::memory_order_relaxed)) w->parker.unpark();
+}
+
+// ULT body in M:N mode: every resume is one slice, then hand the worker back.
+// With preemption on, the slice computes until the worker's tick switches
+// it out.
+static void mn_trampoline(void* arg) {
+    std::size_t idx = reinterpret_cast<std::size_t>(arg);
+    while (!g_contexts[idx].finished) {
+        g_mn_mtx.lock();
+        ++g_mn_counter;
+        g_mn_mtx.unlock();
+        if (!ult_spin_until_tick()) ult_yield();
+    }
+    g_contexts[idx].park.store(ULT_EXITED, std::memory_order_release);
+    ult_yield();
+}
+
+// steal up to half of some victim's published ULTs into `local`
+static bool steal_into(MNState& st, Worker& self, LocalPolicy& local, std::mt19937& rng) {
+    int n = static_cast<int>(st.workers.size());
+    int start = std::uniform_int_distribution<int>(0, n - 1)(rng);
+    for (int k = 0; k < n; ++k) {
+        Worker& victim = *st.workers[(start + k) % n];
+        if (&victim == &self) continue;
+
+        std::size_t want = std::max<std::size_t>(1, victim.deque.size_estimate() / 2);
+        want = std::min(want, LOCAL_WINDOW);
+        std::size_t got = 0, idx;
+        while (got < want && victim.deque.steal(idx)) {
+            local.push(idx);
+            ++got;
+        }
+        if (got) {
+            self.steals += static_cast<long>(got);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void worker_loop(MNState& st, Worker& w) {
+    ThreadedScheduler* sched = st.sched;
+    auto& tasks = sched->tasks;
+    const ThreadedAlgorithm algo = sched->algorithm;
+
+    scheduler_fiber = ult_convert_thread();
+    const bool timed = sched->preempt_us > 0 && ult_preempt_thread_init();
+
+    LocalPolicy local(algo, tasks);
+    std::mt19937 rng(static_cast<unsigned>(w.id) + 1);
+    bool idle = false;
+    int idle_spins = 0;
+
+    // A ULT whose work has run out (ctx.finished) is not deleted until its
+    // body has returned: it may have stopped inside lock() or wait(), and
+    // must get to release what it holds. Until then it sits in `draining`
+    // and is resumed outside the policy, with no slice recorded.
+    std::vector<std::size_t> draining;
+    // ULTs handed a lock by a directed yield, to run next
+    std::vector<std::size_t> directed;
+
+    auto resume = [&](std::size_t idx) {
+        ULTContext& ctx = g_contexts[idx];
+        ctx.worker = w.id;
+        g_current_idx = idx;
+        ult_switch_to(ctx.fiber);
+        if (g_ult_next != ULT_NIL) {
+            directed.push_back(g_ult_next);
+            g_ult_next = ULT_NIL;
+        }
+    };
+    auto retire = [&](std::size_t idx) {
+        ULTContext& ctx = g_contexts[idx];
+        ult_delete_fiber(ctx.fiber);
+        ctx.fiber = nullptr;
+        // the last one out wakes the sleepers so they see the run is over
+        if (st.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            for (auto& o : st.workers) o->parker.unpark();
+        }
+    };
+    auto requeue = [&](std::size_t idx) {
+        if (g_contexts[idx].finished) draining.push_back(idx);
+        else local.push(idx);
+    };
+    // after idx switched back: the policy's bookkeeping for it must be done
+    // by now, since once its park commits its waker may requeue it anywhere
+    auto settle = [&](std::size_t idx) {
+        if (ult_park_commit(idx)) ++w.parks;
+        else if (g_contexts[idx].park.load(std::memory_order_acquire) == ULT_EXITED) retire(idx);
+        else requeue(idx);
+    };
+
+    g_ult_next = ULT_NIL;
+    while (st.remaining.load(std::memory_order_acquire) > 0) {
+        std::size_t idx;
+        // ULTs woken since they parked here
+        std::size_t woken = w.inbox.exchange(ULT_NIL, std::memory_order_acquire);
+        while (woken != ULT_NIL) {
+            idx = woken;
+            woken = g_contexts[idx].next;
+            requeue(idx);
+        }
+
+        while (!draining.empty()) {
+            idx = draining.back();
+            draining.pop_back();
+            resume(idx);
+            settle(idx);
+        }
+
+        // a directed yield: the last ULT handed a lock to this one, which
+        // runs now rather than keep everyone behind it waiting
+        if (!directed.empty()) {
+            idx = directed.back();
+            directed.pop_back();
+            ++w.handoffs;
+            if (g_contexts[idx].finished) {
+                draining.push_back(idx);
+                continue;
+            }
+        } else {
+            if (local.empty()) {
+                while (local.size() < LOCAL_WINDOW && w.deque.pop(idx)) local.push(idx);
+            }
+            if (local.empty() && !steal_into(st, w, local, rng)) {
+                if (!idle) {
+                    idle = true;
+                    idle_spins = 0;
+                    w.idle.store(true, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    st.idle.fetch_add(1, std::memory_order_relaxed);
+                } else if (++idle_spins < IDLE_SPINS) {
+                    std::this_thread::yield();
+                } else {
+                    // nothing for a while: sleep rather than burn the core
+                    idle_spins = 0;
+                    w.parker.park();
+                }
+                continue;
+            }
+            if (idle) {
+                idle = false;
+                w.idle.store(false, std::memory_order_relaxed);
+                st.idle.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            // another worker is starving: publish our surplus so it can steal
+            if (st.idle.load(std::memory_order_relaxed) > 0) {
+                bool spilled = false;
+                while (local.size() > 1 && local.spill(idx)) {
+                    w.deque.push(idx);
+                    spilled = true;
+                }
+                if (spilled) wake_idle(st, w);
+            }
+
+            idx = local.pick();
+        }
+        w.clock = std::max(w.clock, tasks.arrival_time[idx]);
+
+        tasks.state[idx] = ThreadState::RUNNING;
+        int run = tasks.remaining_time[idx];
+        if (algo != T_FCFS) {
+            int quantum = (algo == T_MLFQ) ? (sched->time_quantum << tasks.queue_level[idx]) : sched->time_quantum;
+            run = std::min(run, quantum);
+        }
+        w.timeline.emplace_back(tasks.id[idx], w.clock, w.clock + run, tasks.state[idx], tasks.arrival_time[idx], w.id);
+        if (SCHED_LOG_ON(LOG_TRACE, sched->log_level)) {
+            LogEvent ev = { 0, tasks.id[idx], w.clock, w.clock + run, w.id, 0.0 };
+            // the ring is drained concurrently; wait for room rather than drop
+            while (!w.events.push(ev)) std::this_thread::yield();
+        }
+
+        // stacks come from the pool on first dispatch, on whichever worker
+        ULTContext& ctx = g_contexts[idx];
+        if (!ctx.fiber) {
+            ctx.fiber = ult_create_fiber(tasks.stack_size[idx], mn_trampoline, reinterpret_cast<void*>(idx));
+            if (!ctx.fiber) {
+                std::fprintf(stderr, "[MN] ult_create_fiber failed for ULT %zu\n", idx);
+                std::abort();
+            }
+        }
+        long budget = timed ? sched->sliceBudgetUs(run) : 0;
+        if (budget > 0) ult_preempt_arm(budget);
+        resume(idx);
+        if (budget > 0) {
+            if (ult_preempt_pending()) ++w.preempted;
+            ult_preempt_disarm();
+        }
+
+        tasks.remaining_time[idx] -= run;
+        w.clock += run;
+        ++w.slices;
+        if (algo == T_CFS)
+            tasks.vruntime[idx] += run * (CFS_DEFAULT_WEIGHT / tasks.weight[idx]);
+
+        if (tasks.remaining_time[idx] <= 0) {
+            tasks.state[idx] = ThreadState::FINISHED;
+            ctx.finished = true;
+        } else {
+            tasks.state[idx] = ThreadState::READY;
+            if (algo == T_MLFQ)
+                tasks.queue_level[idx] = std::min(tasks.queue_level[idx] + 1, MLFQ_LEVELS - 1);
+        }
+        settle(idx);
+    }
+
+    if (idle) {
+        w.idle.store(false, std::memory_order_relaxed);
+        st.idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+    ult_preempt_thread_exit();
+    ult_convert_back();
+}
+
+void ThreadedScheduler::runParallel() {
+    log("[MN] starting " + std::to_string(workers) + " workers");
+
+    MNState st;
+    st.sched = this;
+    st.remaining.store(static_cast<int>(tasks.size()));
+    for (int i = 0; i < workers; ++i) {
+        st.workers.emplace_back(new Worker());
+        st.workers.back()->id = i;
+    }
+
+    const std::size_t n = tasks.size();
+    g_contexts = std::vector<ULTContext>(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        tasks.queue_level[i] = 0;
+        tasks.vruntime[i] = 0.0;
+        tasks.weight[i] = CFS_DEFAULT_WEIGHT / (1 << tasks.nice[i]);
+        tasks.state[i] = ThreadState::READY;
+    }
+    g_mn = &st;
+    g_ult_wake = mn_wake;
+    g_mn_counter = 0;
+
+    // deal ULTs round-robin in arrival order; each deque is filled latest
+    // first so its owner pops the earliest arrival and thieves take the latest
+    std::vector<std::size_t> order(n);
+    for (std::size_t i = 0; i < n; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return tasks.arrival_time[a] < tasks.arrival_time[b];
+    });
+    for (std::size_t k = n; k-- > 0;)
+        st.workers[k % workers]->deque.push(order[k]);
+
+    // format the workers' slice events here, off their scheduling loops
+    auto drain = [&] {
+        for (auto& w : st.workers)
+            w->events.drain([this](const LogEvent& ev) {
+                write("[MN] W" + std::to_string(ev.arg) + " T" + std::to_string(ev.id) + " " +
+                      std::to_string(ev.start) + "->" + std::to_string(ev.end));
+            });
+    };
+
+    std::vector<std::thread> threads;
+    for (auto& w : st.workers)
+        threads.emplace_back(worker_loop, std::ref(st), std::ref(*w));
+    if (SCHED_LOG_ON(LOG_TRACE, log_level)) {
+        while (st.remaining.load(std::memory_order_acquire) > 0) {
+            drain();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    for (auto& th : threads)
+        th.join();
+    drain();
+    g_ult_wake = nullptr;
+    g_mn = nullptr;
+
+    for (auto& w : st.workers) {
+        _timeline.insert(_timeline.end(), w->timeline.begin(), w->timeline.end());
+        preempted += w->preempted;
+        std::string line = "[MN] worker " + std::to_string(w->id) + ": " + std::to_string(w->slices) +
+                           " slices, " + std::to_string(w->steals) + " stolen";
+        if (preempt_us > 0) line += ", " + std::to_string(w->preempted) + " preempted";
+        log(line + ", " + std::to_string(w->parks) + " parked, " + std::to_string(w->handoffs) + " handed off");
+    }
+    log("[MN] shared counter " + std::to_string(g_mn_counter));
+    std::stable_sort(_timeline.begin(), _timeline.end(),
+                     [](const ThreadedTimelineEntry& a, const ThreadedTimelineEntry& b) {
+                         if (a.start_time != b.start_time) return a.start_time < b.start_time;
+                         return a.worker < b.worker;
+                     });
+
+    log("[MN] done");
+}
@@ -0,0 +1,179 @@
+#include "ult_stack.h"
+#include <map>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// stacks kept on the free lists before further releases are unmapped
+static const std::size_t MAX_CACHED_STACKS = 4096;
+// top of a released stack that stays resident: the next ULT touches it first
+static const std::size_t HOT_BYTES = 8 * 1024;
+static const std::size_t MIN_STACK = 16 * 1024;
+
+namespace {
+
+struct StackPool {
+    std::mutex mtx;
+    std::map<std::size_t, std::vector<ULTStack>> free_lists;   // by size class
+    std::size_t mapped = 0;
+    std::size_t in_use = 0;
+    std::size_t cached = 0;
+    std::size_t reused = 0;
+};
+
+StackPool& pool() {
+    static StackPool p;
+    return p;
+}
+
+std::size_t page_size() {
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwPageSize;
+#else
+    static const std::size_t ps = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return ps;
+#endif
+}
+
+std::size_t size_class(std::size_t size) {
+    std::size_t c = MIN_STACK;
+    while (c < size) c <<= 1;
+    return c;
+}
+
+bool map_stack(std::size_t size, ULTStack& out) {
+    std::size_t guard = page_size();
+#if defined(_WIN32)
+    char* p = static_cast<char*>(VirtualAlloc(nullptr, size + guard, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (!p) return false;
+    DWORD old;
+    if (!VirtualProtect(p, guard, PAGE_NOACCESS, &old)) {
+        VirtualFree(p, 0, MEM_RELEASE);
+        return false;
+    }
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+    void* m = mmap(nullptr, size + guard, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (m == MAP_FAILED) return false;
+    char* p = static_cast<char*>(m);
+    // stacks grow down, so the guard sits at the low end; a stack without
+    // its guard would overflow silently, so that fails like mmap
+    if (mprotect(p, guard, PROT_NONE) != 0) {
+        munmap(m, size + guard);
+        return false;
+    }
+#endif
+    out.base = p + guard;
+    out.size = size;
+    return true;
+}
+
+void unmap_stack(const ULTStack& s) {
+    std::size_t guard = page_size();
+#if defined(_WIN32)
+    VirtualFree(s.base - guard, 0, MEM_RELEASE);
+#else
+    munmap(s.base - guard, s.size + guard);
+#endif
+}
+
+// let the kernel reclaim the cold part of a parked stack; contents are junk
+// by now, and untouched pages were never committed in the first place
+void decommit_cold(const ULTStack& s) {
+    if (s.size <= HOT_BYTES) return;
+    std::size_t cold = s.size - HOT_BYTES;
+#if defined(_WIN32)
+    VirtualAlloc(s.base, cold, MEM_RESET, PAGE_READWRITE);
+#else
+#ifdef MADV_FREE
+    if (madvise(s.base, cold, MADV_FREE) == 0) return;
+#endif
+    madvise(s.base, cold, MADV_DONTNEED);
+#endif
+}
+
+} // namespace
+
+ULTStack ult_stack_acquire(std::size_t size) {
+    std::size_t cls = size_class(size);
+    StackPool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mtx);
+        auto it = p.free_lists.find(cls);
+        if (it != p.free_lists.end() && !it->second.empty()) {
+            ULTStack s = it->second.back();
+            it->second.pop_back();
+            --p.cached;
+            ++p.in_use;
+            ++p.reused;
+            return s;
+        }
+    }
+
+    ULTStack s = { nullptr, 0 };
+    if (!map_stack(cls, s)) return s;
+
+    std::lock_guard<std::mutex> lock(p.mtx);
+    p.mapped += cls + page_size();
+    ++p.in_use;
+    return s;
+}
+
+void ult_stack_release(ULTStack s) {
+    if (!s.base) return;
+    decommit_cold(s);
+
+    StackPool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mtx);
+        --p.in_use;
+        if (p.cached < MAX_CACHED_STACKS) {
+            ++p.cached;
+            p.free_lists[s.size].push_back(s);
+            return;
+        }
+        p.mapped -= s.size + page_size();
+    }
+    unmap_stack(s);
+}
+
+void ult_stack_trim() {
+    std::vector<ULTStack> victims;
+    StackPool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mtx);
+        for (auto& fl : p.free_lists) {
+            for (auto& s : fl.second) {
+                victims.push_back(s);
+                p.mapped -= s.size + page_size();
+            }
+            fl.second.clear();
+        }
+        p.cached = 0;
+    }
+    for (auto& s : victims) unmap_stack(s);
+}
+
+ULTStackStats ult_stack_stats() {
+    StackPool& p = pool();
+    std::lock_guard<std::mutex> lock(p.mtx);
+    return ULTStackStats{ p.mapped, p.in_use, p.cached, p.reused };
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+
+// ULT stack allocator.
+// On POSIX every stack is its own anonymous mapping with a PROT_NONE guard
+// page below it, reserved with MAP_NORESERVE so pages are only committed when
+// the ULT actually touches them. Released stacks go back to a free list
+// (bucketed by power-of-two size) and are handed out again to later ULTs and
+// later runs; their cold pages are given back to the kernel with MADV_FREE.
+// Win32 keeps using fiber-managed stacks (see ult_context.cpp).
+
+struct ULTStack {
+  char*       base;   // lowest usable byte (just above the guard page)
+  std::size_t size;   // usable bytes
+};
+
+struct ULTStackStats {
+  std::size_t mapped_bytes;   // address space held by the pool (incl. guards)
+  std::size_t in_use;         // stacks currently owned by a fiber
+  std::size_t cached;         // stacks sitting on the free lists
+  std::size_t reused;         // acquisitions served from the free lists
+};
+
+ULTStack      ult_stack_acquire(std::size_t size);
+void          ult_stack_release(ULTStack stack);
+void          ult_stack_trim();          // unmap every cached stack
+ULTStackStats ult_stack_stats();
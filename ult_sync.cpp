@@ -0,0 +1,417 @@
+#include "ult_sync.h"
+#include <algorithm>
+#include <vector>
+
+// spins a contended lock() may burn before parking; the actual budget
+// follows how long recent spins took to win the lock
+static const int MAX_SPIN = 256;
+
+// detection settings and counters; only contended paths touch them
+static std::atomic<int> g_dl_policy{ULT_DEADLOCK_REPORT};
+static std::atomic<int> g_dl_victim{ULT_VICTIM_REQUESTER};
+static std::atomic<long> g_dl_checks{0}, g_dl_steps{0}, g_dl_longest{0};
+static std::atomic<long> g_dl_cycles{0}, g_dl_revocations{0};
+static std::size_t g_dl_last_len = 0;           // under g_dl_recover
+static std::size_t g_dl_last_victim = ULT_NIL;  // under g_dl_recover
+static ULTSpinLock g_dl_recover;    // serialises confirmation and recovery
+
+ULTWakeFn g_ult_wake = nullptr;
+thread_local std::size_t g_ult_next = ULT_NIL;
+
+// From here until it runs again the ULT must not be switched out by the
+// timer: that switch would commit the park before the ULT is on its way.
+std::size_t ult_prepare_park() {
+  ult_preempt_disable();
+  std::size_t self = g_current_idx;
+  g_contexts[self].park.store(ULT_PARKING, std::memory_order_relaxed);
+  return self;
+}
+
+void ult_park() {
+  // g_current_idx belongs to whichever worker resumes us, so keep our own
+  std::size_t self = g_current_idx;
+  ult_yield();
+  g_contexts[self].park.store(ULT_RUNNING, std::memory_order_relaxed);
+  ult_preempt_enable();
+}
+
+void ult_unpark(std::size_t idx) {
+  int prev = g_contexts[idx].park.exchange(ULT_WOKEN, std::memory_order_acq_rel);
+  // still PARKING: its scheduler has not seen the switch yet and will
+  // requeue it itself when ult_park_commit() fails
+  if (prev == ULT_PARKED && g_ult_wake) g_ult_wake(idx);
+}
+
+// with yield false the caller is about to switch out anyway (it is parking),
+// and that switch becomes the directed yield
+void ult_handoff(std::size_t idx, bool yield) {
+  if (!g_ult_wake) {
+    // single-worker: the policy decides when it runs
+    ult_unpark(idx);
+    return;
+  }
+  int prev = g_contexts[idx].park.exchange(ULT_WOKEN, std::memory_order_acq_rel);
+  // still PARKING: its own worker has yet to switch out and requeues it
+  if (prev != ULT_PARKED) return;
+  g_ult_next = idx;
+  if (yield) ult_yield();
+}
+
+bool ult_park_commit(std::size_t idx) {
+  int expected = ULT_PARKING;
+  return g_contexts[idx].park.compare_exchange_strong(expected, ULT_PARKED, std::memory_order_acq_rel);
+}
+
+void ULTMutex::lock_slow() {
+  // the owner is likely running on another worker: spin a little first
+  int limit = std::min(MAX_SPIN, 2 * spin_estimate.load(std::memory_order_relaxed) + 10);
+  for (int i = 0; i < limit; ++i) {
+    int c = state.load(std::memory_order_relaxed);
+    if (c == 0 && state.compare_exchange_weak(c, 1, std::memory_order_acquire)) {
+      owner.store(g_current_idx, std::memory_order_relaxed);
+      int est = spin_estimate.load(std::memory_order_relaxed);
+      spin_estimate.store(est + (i - est) / 8, std::memory_order_relaxed);
+      return;
+    }
+    ult_cpu_relax();
+  }
+  int est = spin_estimate.load(std::memory_order_relaxed);
+  spin_estimate.store(est + (limit - est) / 8, std::memory_order_relaxed);
+
+  guard.lock();
+  // mark it contended; if it was released meanwhile it is ours
+  if (state.exchange(2, std::memory_order_acquire) == 0) {
+    owner.store(g_current_idx, std::memory_order_relaxed);
+    guard.unlock();
+    return;
+  }
+  std::size_t self = ult_prepare_park();
+  waiters.push(self);
+  g_contexts[self].blocked_on.store(this, std::memory_order_seq_cst);
+  guard.unlock();
+  if (g_dl_policy.load(std::memory_order_relaxed) != ULT_DEADLOCK_OFF) detect(self, this);
+  ult_park();
+  // the lock was handed straight to us; take back any that were revoked
+  if (g_contexts[self].revoked) reclaim(self);
+}
+
+void ULTMutex::unlock_slow(bool yield) {
+  guard.lock();
+  std::size_t next = grant_locked();
+  guard.unlock();
+  if (next != ULT_NIL) ult_handoff(next, yield);
+}
+
+// With guard held: pick the next owner, or free the lock if there is none.
+// The lock passes over without ever being released, so nobody barges in.
+std::size_t ULTMutex::grant_locked() {
+  // a single-worker scheduler may retire a parked ULT; never hand it the lock
+  std::size_t next = waiters.pop_live();
+  owner.store(next, std::memory_order_relaxed);
+  if (next != ULT_NIL) g_contexts[next].blocked_on.store(nullptr, std::memory_order_relaxed);
+  state.store(next == ULT_NIL ? 0 : (waiters.empty() ? 1 : 2), std::memory_order_release);
+  return next;
+}
+
+// wait morphing: ULTs parked on a condition variable join our wait list
+// without being woken; each resumes once, owning the lock
+void ULTMutex::requeue(ULTWaitList &moved) {
+  if (moved.empty()) return;
+  guard.lock();
+  waiters.append(moved);
+  std::size_t next = ULT_NIL;
+  // contended from now on; if it was free, the first of them takes it
+  if (state.exchange(2, std::memory_order_acquire) == 0) next = grant_locked();
+  guard.unlock();
+  if (next != ULT_NIL) ult_handoff(next);
+}
+
+void ULTCondVar::wait(ULTMutex &m) {
+  guard.lock();
+  mutex = &m;
+  waiters.push(ult_prepare_park());
+  guard.unlock();
+  m.owner.store(ULT_NIL, std::memory_order_relaxed);
+  int c = 1;
+  if (!m.state.compare_exchange_strong(c, 0, std::memory_order_release))
+    m.unlock_slow(false);
+  ult_park();
+  // signal/broadcast moved us onto m's wait list, which handed us m
+}
+
+void ULTCondVar::signal() {
+  ULTWaitList moved;
+  guard.lock();
+  std::size_t idx = waiters.pop();
+  if (idx != ULT_NIL) moved.push(idx);
+  ULTMutex *m = mutex;
+  guard.unlock();
+  if (m) m->requeue(moved);
+}
+
+void ULTCondVar::broadcast() {
+  ULTWaitList moved;
+  guard.lock();
+  moved.append(waiters);
+  ULTMutex *m = mutex;
+  guard.unlock();
+  if (m) m->requeue(moved);
+}
+
+void ult_deadlock_configure(ULTDeadlockPolicy policy, ULTDeadlockVictim victim) {
+  g_dl_policy.store(policy, std::memory_order_relaxed);
+  g_dl_victim.store(victim, std::memory_order_relaxed);
+}
+
+ULTDeadlockPolicy ult_deadlock_policy() {
+  return static_cast<ULTDeadlockPolicy>(g_dl_policy.load(std::memory_order_relaxed));
+}
+
+ULTDeadlockStats ult_deadlock_stats() {
+  ULTDeadlockStats st;
+  st.checks = g_dl_checks.load(std::memory_order_relaxed);
+  st.walk_steps = g_dl_steps.load(std::memory_order_relaxed);
+  st.longest_walk = g_dl_longest.load(std::memory_order_relaxed);
+  st.cycles = g_dl_cycles.load(std::memory_order_relaxed);
+  st.revocations = g_dl_revocations.load(std::memory_order_relaxed);
+  g_dl_recover.lock();
+  st.last_cycle_len = g_dl_last_len;
+  st.last_victim = g_dl_last_victim;
+  g_dl_recover.unlock();
+  return st;
+}
+
+void ult_deadlock_reset_stats() {
+  g_dl_checks = 0;
+  g_dl_steps = 0;
+  g_dl_longest = 0;
+  g_dl_cycles = 0;
+  g_dl_revocations = 0;
+  g_dl_recover.lock();
+  g_dl_last_len = 0;
+  g_dl_last_victim = ULT_NIL;
+  g_dl_recover.unlock();
+}
+
+// Called by `self` right after it published self -> m, before it parks.
+// Out-degree one means any cycle through the new edge returns to self, so
+// we follow owner -> blocked_on links without locks. Whichever ULT closes
+// a cycle last sees it complete. The walk stops early at a running ULT.
+// (Waiters moved here from a condition variable carry no edge.)
+void ULTMutex::detect(std::size_t self, ULTMutex *m) {
+  g_dl_checks.fetch_add(1, std::memory_order_relaxed);
+  // ults[i] waits for mutexes[i]; reused, as the check never switches out
+  static thread_local std::vector<std::size_t> ults;
+  static thread_local std::vector<ULTMutex *> mutexes;
+  ults.clear();
+  mutexes.clear();
+  ults.push_back(self);
+  mutexes.push_back(m);
+  bool cycle = false;
+  long steps = 0;
+  for (ULTMutex *cur = m; steps <= static_cast<long>(g_contexts.size()); ++steps) {
+    std::size_t o = cur->owner.load(std::memory_order_seq_cst);
+    if (o == ULT_NIL || o >= g_contexts.size()) break;
+    if (o == self) {
+      cycle = true;
+      break;
+    }
+    const ULTContext &ctx = g_contexts[o];
+    if (ctx.park.load(std::memory_order_relaxed) == ULT_EXITED) break;
+    const void *b = ctx.blocked_on.load(std::memory_order_seq_cst);
+    if (!b) break;
+    cur = const_cast<ULTMutex *>(static_cast<const ULTMutex *>(b));
+    ults.push_back(o);
+    mutexes.push_back(cur);
+  }
+  g_dl_steps.fetch_add(steps, std::memory_order_relaxed);
+  long longest = g_dl_longest.load(std::memory_order_relaxed);
+  while (steps > longest && !g_dl_longest.compare_exchange_weak(longest, steps, std::memory_order_relaxed)) {}
+  if (!cycle) return;
+
+  // Confirm: with every guard on the cycle held no mutex can change hands,
+  // so the edges we saw either all still hold or it was a stale read.
+  g_dl_recover.lock();
+  std::vector<ULTMutex *> order(mutexes);
+  std::sort(order.begin(), order.end());
+  for (ULTMutex *x : order) x->guard.lock();
+  std::size_t n = ults.size();
+  bool live = true;
+  for (std::size_t i = 0; i < n && live; ++i)
+    live = g_contexts[ults[i]].park.load(std::memory_order_relaxed) != ULT_EXITED &&
+           g_contexts[ults[i]].blocked_on.load(std::memory_order_relaxed) == mutexes[i] &&
+           mutexes[i]->owner.load(std::memory_order_relaxed) == ults[(i + 1) % n];
+
+  std::size_t woken = ULT_NIL;
+  if (live) {
+    g_dl_cycles.fetch_add(1, std::memory_order_relaxed);
+    g_dl_last_len = n;
+    if (g_dl_policy.load(std::memory_order_relaxed) == ULT_DEADLOCK_REVOKE) {
+      std::size_t v = 0;                  // position of the victim in ults
+      int victim = g_dl_victim.load(std::memory_order_relaxed);
+      for (std::size_t i = 1; i < n; ++i) {
+        if (victim == ULT_VICTIM_YOUNGEST && ults[i] > ults[v]) v = i;
+        if (victim == ULT_VICTIM_OLDEST && ults[i] < ults[v]) v = i;
+      }
+      // the victim owns the mutex its predecessor on the cycle waits for:
+      // pass that to its first waiter as if the victim had unlocked it
+      ULTMutex *taken = mutexes[(v + n - 1) % n];
+      woken = taken->grant_locked();
+      ULTContext &vc = g_contexts[ults[v]];
+      taken->revoked_next = static_cast<ULTMutex *>(vc.revoked);
+      vc.revoked = taken;
+      g_dl_last_victim = ults[v];
+      g_dl_revocations.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  for (ULTMutex *x : order) x->guard.unlock();
+  g_dl_recover.unlock();
+  if (woken != ULT_NIL) ult_unpark(woken);
+}
+
+// the victim of a revocation, back from its park: relock what was taken
+void ULTMutex::reclaim(std::size_t self) {
+  ULTContext &ctx = g_contexts[self];
+  while (ctx.revoked) {
+    ULTMutex *m = static_cast<ULTMutex *>(ctx.revoked);
+    ctx.revoked = m->revoked_next;
+    m->revoked_next = nullptr;
+    m->lock();
+    ult_preempt_enable();     // still counted from the lock() it was taken in
+  }
+}
+
+void ULTSemaphore::acquire_slow() {
+  // our claim is already in count; the matching release hands us a permit
+  guard.lock();
+  if (tokens > 0) {           // it came before we could enqueue
+    --tokens;
+    guard.unlock();
+    return;
+  }
+  waiters.push(ult_prepare_park());
+  guard.unlock();
+  ult_park();
+}
+
+void ULTSemaphore::release_slow() {
+  guard.lock();
+  for (;;) {
+    std::size_t idx = waiters.pop();
+    if (idx == ULT_NIL) {     // the claimant has not enqueued yet
+      ++tokens;
+      break;
+    }
+    if (g_contexts[idx].park.load(std::memory_order_relaxed) != ULT_EXITED) {
+      guard.unlock();
+      ult_unpark(idx);
+      return;
+    }
+    // retired while waiting: drop its claim, and stop once no claim is left
+    // for this permit to go to
+    if (count.fetch_add(1, std::memory_order_relaxed) >= 0) break;
+  }
+  guard.unlock();
+}
+
+bool ULTRWLock::try_lock_shared() {
+  ult_preempt_disable();
+  unsigned s = state.load(std::memory_order_relaxed);
+  while (!(s & (WRITER | WAITERS)))
+    if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) return true;
+  ult_preempt_enable();
+  return false;
+}
+
+// Slow paths run under guard. While WAITERS is set every fast-path acquire
+// fails, so the state only changes here or through holders releasing.
+void ULTRWLock::lock_shared_slow() {
+  guard.lock();
+  unsigned s = state.load(std::memory_order_relaxed);
+  for (;;) {
+    if (!(s & WRITER) && waiting_writers == 0) {
+      if (state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+        guard.unlock();
+        return;
+      }
+    } else if (state.compare_exchange_weak(s, s | WAITERS, std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  readers.push(ult_prepare_park());
+  guard.unlock();
+  ult_park();
+  // release_slow counted us in before waking us
+}
+
+void ULTRWLock::lock_slow() {
+  guard.lock();
+  unsigned s = state.load(std::memory_order_relaxed);
+  for (;;) {
+    if (!(s & (WRITER | READERS))) {
+      if (state.compare_exchange_weak(s, s | WRITER, std::memory_order_acquire)) {
+        guard.unlock();
+        return;
+      }
+    } else if (state.compare_exchange_weak(s, s | WAITERS, std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  ++waiting_writers;
+  writers.push(ult_prepare_park());
+  guard.unlock();
+  ult_park();
+  // the lock was handed straight to us
+}
+
+void ULTRWLock::release_slow(bool writer) {
+  guard.lock();
+  if (writer) state.fetch_sub(WRITER, std::memory_order_release);
+  // a slow-path acquire may have taken it since; its release comes back here
+  if (state.load(std::memory_order_relaxed) & (WRITER | READERS)) {
+    guard.unlock();
+    return;
+  }
+
+  std::size_t next = ULT_NIL;
+  while ((next = writers.pop()) != ULT_NIL) {
+    --waiting_writers;
+    if (g_contexts[next].park.load(std::memory_order_relaxed) != ULT_EXITED) break;
+  }
+  if (next != ULT_NIL) {
+    bool more = !writers.empty() || !readers.empty();
+    state.store(WRITER | (more ? WAITERS : 0), std::memory_order_release);
+    guard.unlock();
+    ult_handoff(next);
+    return;
+  }
+
+  // no writer waiting: admit every reader at once
+  ULTWaitList woken;
+  unsigned n = 0;
+  for (std::size_t idx = readers.pop_live(); idx != ULT_NIL; idx = readers.pop_live()) {
+    woken.push(idx);
+    ++n;
+  }
+  state.store(n, std::memory_order_release);
+  guard.unlock();
+  for (std::size_t idx = woken.pop(); idx != ULT_NIL; idx = woken.pop())
+    ult_unpark(idx);
+}
+
+bool ULTBarrier::arrive_and_wait() {
+  guard.lock();
+  if (++arrived < parties) {
+    waiters.push(ult_prepare_park());
+    guard.unlock();
+    ult_park();
+    return false;
+  }
+  arrived = 0;
+  ULTWaitList woken;
+  woken.append(waiters);
+  guard.unlock();
+  for (std::size_t idx = woken.pop_live(); idx != ULT_NIL; idx = woken.pop_live())
+    ult_unpark(idx);
+  return true;
+}
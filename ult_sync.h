@@ -1,46 +1,403 @@
 #pragma once
 #include "ult_context.h"
+#include "ult_preempt.h"
+#include <utility>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-class ULTMutex {
+// ULT synchronization, safe across M:N workers.
+// Each primitive has a lock-free fast path on one atomic word. A ULT that
+// must block parks instead of spinning: it links itself into the
+// primitive's intrusive wait list (guarded by a per-primitive spinlock held
+// for a few instructions, never across a switch) and yields. Waking it
+// hands it back to the worker that last ran it, through that worker's wake
+// inbox; in single-worker mode a parked ULT is simply skipped until woken.
+// Besides the mutex and condition variable there are a reader-writer lock,
+// a counting semaphore, a barrier and a bounded channel, all parking the
+// same way.
+//
+// A contended unlock passes the mutex straight to its first waiter, and in
+// M:N mode yields the worker to it (directed yield) so the new owner runs
+// now instead of holding the lock from a run queue. Condition variables
+// never wake a waiter just to have it block on the mutex: signal and
+// broadcast move waiters onto the mutex's wait list (wait morphing), and
+// each is resumed once, already owning the mutex.
+//
+// Holding a ULTMutex, a ULTRWLock or a ULTSpinLock keeps the preemption
+// timer from switching the ULT out (ult_preempt.h); a tick that fires
+// meanwhile is taken by the unlock that drops the last of them.
+//
+// ULTMutex also detects deadlocks online. Each mutex records its owner
+// (a plain store on the fast path), and a ULT about to park records the
+// mutex it waits for. Since a blocked ULT waits for exactly one mutex with
+// one owner, the wait-for graph has out-degree one, and the edge a ULT adds
+// can only close a cycle through the ULT itself: following owners from it
+// finds that cycle in a few steps. A suspected cycle is confirmed with the
+// guards of its mutexes held, then reported and, under ULT_DEADLOCK_REVOKE,
+// broken by revoking one mutex from a victim ULT. The victim takes it back
+// before its own lock() returns. The data that mutex protects may then be
+// in whatever state the victim left it.
+
+// park protocol, per ULTContext::park:
+//   RUNNING -> PARKING      ULT, before it publishes itself on a wait list
+//   PARKING -> PARKED       scheduler, once the ULT has switched out
+//   PARKING|PARKED -> WOKEN waker; if it was PARKED the waker requeues it
+//   WOKEN   -> RUNNING      the ULT, once resumed
+//   RUNNING -> EXITED       the ULT, as its body returns (or when retired)
+enum ULTParkState : int { ULT_RUNNING, ULT_PARKING, ULT_PARKED, ULT_WOKEN, ULT_EXITED };
+
+static const std::size_t ULT_NIL = SIZE_MAX;
+
+// where a woken ULT goes; set by the M:N runtime, null in single-worker mode
+typedef void (*ULTWakeFn)(std::size_t idx);
+extern ULTWakeFn g_ult_wake;
+// ULT the current worker runs next, set by a directed yield (M:N only)
+extern thread_local std::size_t g_ult_next;
+
+std::size_t ult_prepare_park();         // mark the current ULT, return its index
+void        ult_park();                 // switch out until ult_unpark()
+void        ult_unpark(std::size_t idx);
+void        ult_handoff(std::size_t idx, bool yield = true);  // unpark, run it next
+bool        ult_park_commit(std::size_t idx);   // scheduler: did it park?
+
+inline void ult_cpu_relax() {
+#if defined(_MSC_VER)
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+class ULTSpinLock {
 public:
   void lock() {
-    if (!locked) { locked = true; return; }
-    waiters.push_back(g_current_idx);
-    ::SwitchToFiber(scheduler_fiber);
-    // when we return here, the lock has been granted
+    ult_preempt_disable();
+    while (flag.exchange(true, std::memory_order_acquire))
+      while (flag.load(std::memory_order_relaxed)) ult_cpu_relax();
   }
   void unlock() {
-    if (waiters.empty()) locked = false;
-    else {
-      auto next = waiters.front(); waiters.pop_front();
-      ready_queue.push_back(next);
+    flag.store(false, std::memory_order_release);
+    ult_preempt_enable();
+  }
+private:
+  std::atomic<bool> flag{false};
+};
+
+// FIFO of ULT indices linked through ULTContext::next
+class ULTWaitList {
+public:
+  bool empty() const { return head == ULT_NIL; }
+  void push(std::size_t idx) {
+    g_contexts[idx].next = ULT_NIL;
+    if (tail == ULT_NIL) head = idx;
+    else g_contexts[tail].next = idx;
+    tail = idx;
+  }
+  std::size_t pop() {
+    std::size_t idx = head;
+    if (idx != ULT_NIL) {
+      head = g_contexts[idx].next;
+      if (head == ULT_NIL) tail = ULT_NIL;
+    }
+    return idx;
+  }
+  // pop, skipping ULTs a single-worker scheduler retired while they waited
+  std::size_t pop_live() {
+    std::size_t idx = pop();
+    while (idx != ULT_NIL && g_contexts[idx].park.load(std::memory_order_relaxed) == ULT_EXITED)
+      idx = pop();
+    return idx;
+  }
+  void append(ULTWaitList &other) {     // move other's chain to our tail
+    if (other.empty()) return;
+    if (tail == ULT_NIL) head = other.head;
+    else g_contexts[tail].next = other.head;
+    tail = other.tail;
+    other.head = other.tail = ULT_NIL;
+  }
+private:
+  std::size_t head = ULT_NIL, tail = ULT_NIL;
+};
+
+enum ULTDeadlockPolicy : int {
+  ULT_DEADLOCK_OFF,       // no detection; the owner is still tracked
+  ULT_DEADLOCK_REPORT,    // count cycles, leave the ULTs blocked
+  ULT_DEADLOCK_REVOKE     // break each cycle by revoking a lock from a victim
+};
+
+enum ULTDeadlockVictim : int {
+  ULT_VICTIM_REQUESTER,   // the ULT whose lock() closed the cycle
+  ULT_VICTIM_YOUNGEST,    // the highest ULT index in the cycle
+  ULT_VICTIM_OLDEST       // the lowest ULT index in the cycle
+};
+
+struct ULTDeadlockStats {
+  long checks = 0;              // cycle checks (contended lock() calls)
+  long walk_steps = 0;          // wait-for edges followed, over all checks
+  long longest_walk = 0;
+  long cycles = 0;              // confirmed deadlocks
+  long revocations = 0;
+  std::size_t last_cycle_len = 0;
+  std::size_t last_victim = ULT_NIL;
+};
+
+void ult_deadlock_configure(ULTDeadlockPolicy policy, ULTDeadlockVictim victim = ULT_VICTIM_REQUESTER);
+ULTDeadlockPolicy ult_deadlock_policy();
+ULTDeadlockStats ult_deadlock_stats();
+void ult_deadlock_reset_stats();
+
+class ULTMutex {
+public:
+  void lock() {
+    ult_preempt_disable();
+    int c = 0;
+    if (state.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+      owner.store(g_current_idx, std::memory_order_relaxed);
+      return;
     }
+    lock_slow();
+  }
+  bool try_lock() {
+    ult_preempt_disable();
+    int c = 0;
+    if (!state.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+      ult_preempt_enable();
+      return false;
+    }
+    owner.store(g_current_idx, std::memory_order_relaxed);
+    return true;
+  }
+  void unlock() {
+    owner.store(ULT_NIL, std::memory_order_relaxed);
+    int c = 1;
+    if (!state.compare_exchange_strong(c, 0, std::memory_order_release)) unlock_slow();
+    ult_preempt_enable();
   }
 private:
-  bool locked = false;
-  std::deque<std::size_t> waiters;
+  friend class ULTCondVar;
+  void lock_slow();
+  void unlock_slow(bool yield = true);
+  std::size_t grant_locked();
+  void requeue(ULTWaitList &moved);
+  static void detect(std::size_t self, ULTMutex *m);
+  static void reclaim(std::size_t self);
+
+  std::atomic<int> state{0};        // 0 free, 1 locked, 2 locked with waiters
+  std::atomic<int> spin_estimate{0};  // recent spins that won the lock
+  std::atomic<std::size_t> owner{ULT_NIL};  // holding ULT, exact while state is 2
+  ULTSpinLock guard;                // protects waiters
+  ULTWaitList waiters;
+  ULTMutex *revoked_next = nullptr; // link on the victim's ULTContext::revoked
 };
 
 class ULTCondVar {
 public:
-  void wait(ULTMutex &m) {
-    waiters.push_back(g_current_idx);
-    m.unlock();
-    ::SwitchToFiber(scheduler_fiber);
-    m.lock();
+  void wait(ULTMutex &m);
+  void signal();
+  void broadcast();
+private:
+  ULTSpinLock guard;
+  ULTWaitList waiters;
+  ULTMutex *mutex = nullptr;    // the one all current waiters passed in
+};
+
+// Counting semaphore. count is permits minus claims, so an uncontended
+// acquire/release is one atomic add; a negative count means ULTs are
+// waiting, and release then hands its permit straight to one of them.
+class ULTSemaphore {
+public:
+  explicit ULTSemaphore(long initial = 0) : count(initial) {}
+  void acquire() {
+    if (count.fetch_sub(1, std::memory_order_acquire) > 0) return;
+    acquire_slow();
+  }
+  bool try_acquire() {
+    long c = count.load(std::memory_order_relaxed);
+    while (c > 0)
+      if (count.compare_exchange_weak(c, c - 1, std::memory_order_acquire)) return true;
+    return false;
   }
-  void signal() {
-    if (!waiters.empty()) {
-      auto idx = waiters.front(); waiters.pop_front();
-      ready_queue.push_back(idx);
+  void release() {
+    if (count.fetch_add(1, std::memory_order_release) >= 0) return;
+    release_slow();
+  }
+  long value() const { return count.load(std::memory_order_relaxed); }
+private:
+  void acquire_slow();
+  void release_slow();
+
+  std::atomic<long> count;
+  long tokens = 0;            // permits released before their waiter parked
+  ULTSpinLock guard;
+  ULTWaitList waiters;
+};
+
+// Reader-writer lock with writer preference: once a writer waits, new
+// readers queue behind it, and a release wakes writers before readers.
+// Readers and writers acquire uncontended with one compare-and-swap.
+class ULTRWLock {
+public:
+  void lock_shared() {
+    ult_preempt_disable();
+    unsigned s = state.load(std::memory_order_relaxed);
+    if (!(s & (WRITER | WAITERS)) &&
+        state.compare_exchange_strong(s, s + 1, std::memory_order_acquire)) return;
+    lock_shared_slow();
+  }
+  bool try_lock_shared();
+  void unlock_shared() {
+    // last reader out with ULTs waiting: pass the lock on
+    if (state.fetch_sub(1, std::memory_order_release) == (WAITERS | 1)) release_slow(false);
+    ult_preempt_enable();
+  }
+  void lock() {
+    ult_preempt_disable();
+    unsigned s = 0;
+    if (state.compare_exchange_strong(s, WRITER, std::memory_order_acquire)) return;
+    lock_slow();
+  }
+  bool try_lock() {
+    ult_preempt_disable();
+    unsigned s = 0;
+    if (state.compare_exchange_strong(s, WRITER, std::memory_order_acquire)) return true;
+    ult_preempt_enable();
+    return false;
+  }
+  void unlock() {
+    unsigned s = WRITER;
+    if (!state.compare_exchange_strong(s, 0, std::memory_order_release)) release_slow(true);
+    ult_preempt_enable();
+  }
+private:
+  static const unsigned WRITER = 1u << 30;
+  static const unsigned WAITERS = 1u << 31;   // someone is parked
+  static const unsigned READERS = WRITER - 1;
+
+  void lock_shared_slow();
+  void lock_slow();
+  void release_slow(bool writer);
+
+  std::atomic<unsigned> state{0};   // reader count | WRITER | WAITERS
+  int waiting_writers = 0;          // guarded
+  ULTSpinLock guard;
+  ULTWaitList readers, writers;
+};
+
+// Barrier for a fixed number of ULTs; reusable. arrive_and_wait() returns
+// true in exactly one ULT per round (the last to arrive).
+class ULTBarrier {
+public:
+  explicit ULTBarrier(std::size_t n) : parties(n) {}
+  bool arrive_and_wait();
+private:
+  std::size_t parties;
+  std::size_t arrived = 0;  // guarded
+  ULTSpinLock guard;
+  ULTWaitList waiters;
+};
+
+// Bounded multi-producer multi-consumer channel. send() parks while the
+// buffer is full and recv() while it is empty; after close(), send fails
+// and recv drains what is left, then fails.
+template <typename T>
+class ULTChannel {
+public:
+  explicit ULTChannel(std::size_t capacity) : buf(capacity ? capacity : 1) {}
+
+  bool send(T v) {
+    guard.lock();
+    while (!closed && size == buf.size()) {
+      senders.push(ult_prepare_park());
+      guard.unlock();
+      ult_park();
+      guard.lock();
+    }
+    if (closed) {
+      guard.unlock();
+      return false;
     }
+    push_locked(std::move(v));
+    std::size_t r = receivers.pop_live();
+    guard.unlock();
+    if (r != ULT_NIL) ult_unpark(r);
+    return true;
   }
-  void broadcast() {
-    while (!waiters.empty()) {
-      auto idx = waiters.front(); waiters.pop_front();
-      ready_queue.push_back(idx);
+
+  bool try_send(T v) {
+    guard.lock();
+    if (closed || size == buf.size()) {
+      guard.unlock();
+      return false;
+    }
+    push_locked(std::move(v));
+    std::size_t r = receivers.pop_live();
+    guard.unlock();
+    if (r != ULT_NIL) ult_unpark(r);
+    return true;
+  }
+
+  bool recv(T &out) {
+    guard.lock();
+    while (size == 0 && !closed) {
+      receivers.push(ult_prepare_park());
+      guard.unlock();
+      ult_park();
+      guard.lock();
+    }
+    if (size == 0) {          // closed and drained
+      guard.unlock();
+      return false;
     }
+    pop_locked(out);
+    std::size_t s = senders.pop_live();
+    guard.unlock();
+    if (s != ULT_NIL) ult_unpark(s);
+    return true;
   }
+
+  bool try_recv(T &out) {
+    guard.lock();
+    if (size == 0) {
+      guard.unlock();
+      return false;
+    }
+    pop_locked(out);
+    std::size_t s = senders.pop_live();
+    guard.unlock();
+    if (s != ULT_NIL) ult_unpark(s);
+    return true;
+  }
+
+  void close() {
+    ULTWaitList woken;
+    guard.lock();
+    closed = true;
+    woken.append(senders);
+    woken.append(receivers);
+    guard.unlock();
+    for (std::size_t idx = woken.pop_live(); idx != ULT_NIL; idx = woken.pop_live())
+      ult_unpark(idx);
+  }
+
 private:
-  std::deque<std::size_t> waiters;
+  void push_locked(T v) {
+    std::size_t tail = head + size;
+    if (tail >= buf.size()) tail -= buf.size();
+    buf[tail] = std::move(v);
+    ++size;
+  }
+  void pop_locked(T &out) {
+    out = std::move(buf[head]);
+    if (++head == buf.size()) head = 0;
+    --size;
+  }
+
+  std::vector<T> buf;
+  std::size_t head = 0, size = 0;
+  bool closed = false;
+  ULTSpinLock guard;
+  ULTWaitList senders, receivers;
 };
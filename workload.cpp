@@ -0,0 +1,266 @@
+#include "workload.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+static const std::size_t CSV_BUFFER = 1 << 20;       // bytes
+static const std::size_t BIN_BLOCK_RECORDS = 4096;
+static const std::size_t FIELDS = 6;
+static const std::size_t RECORD_BYTES = FIELDS * 4;
+static const char MAGIC[4] = { 'T', 'S', 'W', 'L' };
+static const std::uint32_t VERSION = 1;
+
+// records are little-endian regardless of host byte order
+static std::int32_t get_le32(const unsigned char *p)
+{
+    std::uint32_t v = std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) |
+                      (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+    return static_cast<std::int32_t>(v);
+}
+
+static void put_le32(unsigned char *p, std::uint32_t v)
+{
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+}
+
+static void fill_task(Task &tk, const long *f)
+{
+    tk = Task{};
+    tk.id = static_cast<int>(f[0]);
+    tk.priority = static_cast<int>(f[1]);
+    tk.remaining_time = static_cast<int>(f[2]);
+    tk.arrival_time = static_cast<int>(f[3]);
+    tk.deadline = static_cast<int>(f[4]);
+    tk.level = static_cast<int>(f[5]);
+}
+
+// ---- CSV -------------------------------------------------------------------
+
+CsvWorkloadReader::CsvWorkloadReader(std::FILE *f)
+    : file(f), buf(CSV_BUFFER + 1)
+{
+}
+
+CsvWorkloadReader::~CsvWorkloadReader()
+{
+    if (file)
+        std::fclose(file);
+}
+
+// move the unread tail to the front and top the buffer up
+bool CsvWorkloadReader::fill()
+{
+    if (eof)
+        return false;
+    std::size_t tail = len - pos;
+    if (tail == CSV_BUFFER)
+        return false;   // a single line fills the whole buffer
+    std::memmove(buf.data(), buf.data() + pos, tail);
+    pos = 0;
+    len = tail;
+    std::size_t got = std::fread(buf.data() + len, 1, CSV_BUFFER - len, file);
+    len += got;
+    if (got == 0)
+    {
+        if (std::ferror(file))
+            err = "read error";
+        eof = true;
+    }
+    return got != 0;
+}
+
+bool CsvWorkloadReader::next(Task &out)
+{
+    while (err.empty())
+    {
+        char *start = buf.data() + pos;
+        char *nl = static_cast<char *>(std::memchr(start, '\n', len - pos));
+        if (!nl)
+        {
+            if (fill())
+                continue;
+            if (!err.empty())
+                return false;
+            if (!eof)
+            {
+                err = "line " + std::to_string(line + 1) + ": line too long";
+                return false;
+            }
+            if (pos == len)
+                return false;
+            nl = buf.data() + len;   // last line without a newline
+            start = buf.data() + pos;
+        }
+        *nl = '\0';
+        pos = static_cast<std::size_t>(nl - buf.data()) + (nl < buf.data() + len ? 1 : 0);
+        ++line;
+
+        char *p = start;
+        while (*p == ' ' || *p == '\t')
+            ++p;
+        if (*p == '\0' || *p == '\r' || *p == '#')
+            continue;
+        // only the first line that is not blank or a comment may be a header
+        const bool first = !started;
+        started = true;
+
+        // five or six int fields, then nothing but trailing blanks
+        long f[FIELDS] = { 0, 0, 0, 0, 0, 0 };
+        std::size_t k = 0;
+        bool ok = false;
+        for (; k < FIELDS; ++k)
+        {
+            char *end;
+            errno = 0;
+            f[k] = std::strtol(p, &end, 10);
+            if (end == p || errno == ERANGE || f[k] < INT_MIN || f[k] > INT_MAX)
+                break;
+            p = end;
+            while (*p == ' ' || *p == '\t')
+                ++p;
+            if (*p != ',')
+            {
+                ++k;
+                while (*p == ' ' || *p == '\t' || *p == '\r')
+                    ++p;
+                ok = *p == '\0' && k >= FIELDS - 1;
+                break;
+            }
+            ++p;
+        }
+
+        if (!ok)
+        {
+            if (first)
+                continue;   // header
+            err = "line " + std::to_string(line) + ": expected id,priority,burst,arrival,deadline[,level]";
+            return false;
+        }
+        fill_task(out, f);
+        return true;
+    }
+    return false;
+}
+
+// ---- binary ----------------------------------------------------------------
+
+BinaryWorkloadReader::BinaryWorkloadReader(std::FILE *f)
+    : file(f), block(BIN_BLOCK_RECORDS * RECORD_BYTES)
+{
+    unsigned char hdr[16];
+    if (std::fread(hdr, 1, sizeof(hdr), file) != sizeof(hdr) ||
+        std::memcmp(hdr, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        err = "not a binary workload";
+        return;
+    }
+    if (std::uint32_t(get_le32(hdr + 4)) != VERSION ||
+        std::uint32_t(get_le32(hdr + 8)) != RECORD_BYTES)
+    {
+        err = "unsupported binary workload version";
+        return;
+    }
+    header_ok = true;
+}
+
+BinaryWorkloadReader::~BinaryWorkloadReader()
+{
+    if (file)
+        std::fclose(file);
+}
+
+bool BinaryWorkloadReader::next(Task &out)
+{
+    if (!header_ok)
+        return false;
+    if (pos == count)
+    {
+        std::size_t got = std::fread(block.data(), 1, block.size(), file);
+        if (got % RECORD_BYTES != 0)
+            err = "truncated record at end of binary workload";
+        count = got / RECORD_BYTES;
+        pos = 0;
+        if (count == 0)
+            return false;
+    }
+
+    const unsigned char *r = block.data() + pos * RECORD_BYTES;
+    long f[FIELDS];
+    for (std::size_t k = 0; k < FIELDS; ++k)
+        f[k] = get_le32(r + 4 * k);
+    ++pos;
+    fill_task(out, f);
+    return true;
+}
+
+bool BinaryWorkloadWriter::open(const std::string &path)
+{
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    failed = false;
+    block.clear();
+    block.reserve(BIN_BLOCK_RECORDS * RECORD_BYTES);
+
+    unsigned char hdr[16] = {};
+    std::memcpy(hdr, MAGIC, sizeof(MAGIC));
+    put_le32(hdr + 4, VERSION);
+    put_le32(hdr + 8, static_cast<std::uint32_t>(RECORD_BYTES));
+    if (std::fwrite(hdr, 1, sizeof(hdr), file) != sizeof(hdr))
+        failed = true;
+    return !failed;
+}
+
+void BinaryWorkloadWriter::write(const Task &tk)
+{
+    if (!file)
+        return;
+    const int f[FIELDS] = { tk.id, tk.priority, tk.remaining_time,
+                            tk.arrival_time, tk.deadline, tk.level };
+    std::size_t at = block.size();
+    block.resize(at + RECORD_BYTES);
+    for (std::size_t k = 0; k < FIELDS; ++k)
+        put_le32(block.data() + at + 4 * k, static_cast<std::uint32_t>(f[k]));
+    if (block.size() >= BIN_BLOCK_RECORDS * RECORD_BYTES)
+        flush();
+}
+
+void BinaryWorkloadWriter::flush()
+{
+    if (!block.empty() && std::fwrite(block.data(), 1, block.size(), file) != block.size())
+        failed = true;
+    block.clear();
+}
+
+bool BinaryWorkloadWriter::close()
+{
+    if (!file)
+        return !failed;
+    flush();
+    if (std::fclose(file) != 0)
+        failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+// ---- factory ---------------------------------------------------------------
+
+std::unique_ptr<WorkloadSource> open_workload(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        return nullptr;
+
+    char magic[sizeof(MAGIC)];
+    bool binary = std::fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                  std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    std::rewind(f);
+    if (binary)
+        return std::unique_ptr<WorkloadSource>(new BinaryWorkloadReader(f));
+    return std::unique_ptr<WorkloadSource>(new CsvWorkloadReader(f));
+}
@@ -0,0 +1,92 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "scheduler.h"
+
+// Streaming workload input for Scheduler.
+// A WorkloadSource yields tasks one at a time in file order (traces are
+// expected to be sorted by arrival_time, like Scheduler::tasks). Readers keep
+// a fixed-size I/O buffer, so a trace of any length is replayed in bounded
+// memory; see Scheduler::setWorkload().
+//
+// Formats:
+//   CSV     id,priority,burst,arrival,deadline[,level]
+//           one task per line; blank lines and '#' comments are skipped,
+//           and so is the first other line if it is not a task (a header).
+//           Any later line that is not a task is an error.
+//   binary  16-byte header ("TSWL", version, record size, reserved), then
+//           one record per task of six little-endian int32 in the CSV order.
+
+class WorkloadSource {
+public:
+    virtual ~WorkloadSource() {}
+
+    // read the next task; false at end of input or on error
+    virtual bool next(Task &out) = 0;
+
+    // non-empty if reading stopped because of malformed input
+    const std::string &error() const { return err; }
+
+protected:
+    std::string err;
+};
+
+class CsvWorkloadReader : public WorkloadSource {
+public:
+    explicit CsvWorkloadReader(std::FILE *f);
+    ~CsvWorkloadReader();
+    bool next(Task &out) override;
+
+private:
+    bool fill();
+
+    std::FILE *file;
+    std::vector<char> buf;
+    std::size_t pos = 0;
+    std::size_t len = 0;
+    bool eof = false;
+    bool started = false;   // past the one line that may be a header
+    long line = 0;
+};
+
+class BinaryWorkloadReader : public WorkloadSource {
+public:
+    explicit BinaryWorkloadReader(std::FILE *f);
+    ~BinaryWorkloadReader();
+    bool next(Task &out) override;
+
+private:
+    std::FILE *file;
+    std::vector<unsigned char> block;
+    std::size_t pos = 0;
+    std::size_t count = 0;
+    bool header_ok = false;
+};
+
+class BinaryWorkloadWriter {
+public:
+    BinaryWorkloadWriter() {}
+    ~BinaryWorkloadWriter() { close(); }
+
+    bool open(const std::string &path);
+    void write(const Task &tk);
+    bool close();   // flushes; false if any write failed
+
+private:
+    void flush();
+
+    std::FILE *file = nullptr;
+    std::vector<unsigned char> block;
+    bool failed = false;
+};
+
+// open a trace, picking the reader from the file's magic; nullptr if the
+// file can't be opened
+std::unique_ptr<WorkloadSource> open_workload(const std::string &path);
+
+#endif // WORKLOAD_H